@@ -0,0 +1,88 @@
+// Проверяет, что последовательный поиск после прогрева выделяет в куче только
+// вектор результата: все временные данные запроса живут в QueryArena.
+#include "search_server.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+atomic<size_t> allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+int failure_count = 0;
+
+template <typename Search>
+void CheckAllocations(const string& name, size_t expected_count, Search search) {
+    search();
+    const size_t before = allocation_count;
+    const vector<Document> documents = search();
+    const size_t count = allocation_count - before;
+    if (count != expected_count) {
+        cerr << name << ": "s << count << " allocations, expected "s << expected_count << endl;
+        ++failure_count;
+    }
+    if (expected_count > 0 && documents.empty()) {
+        cerr << name << ": no documents found"s << endl;
+        ++failure_count;
+    }
+}
+
+int main() {
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (const string& text : {
+            "white cat and yellow hat"s,
+            "curly cat curly tail"s,
+            "nasty dog with big eyes"s,
+            "nasty pigeon john"s,
+        }) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+    }
+    for (int i = 0; i < 1000; ++i) {
+        search_server.AddDocument(++id, "cat catalog word"s + to_string(i % 50), i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { i });
+    }
+
+    CheckAllocations("plus words"s, 1, [&] {
+        return search_server.FindTopDocuments("curly nasty cat"sv);
+    });
+    CheckAllocations("minus words"s, 1, [&] {
+        return search_server.FindTopDocuments("cat -curly -word7 -word8"sv);
+    });
+    CheckAllocations("prefixes"s, 1, [&] {
+        return search_server.FindTopDocuments("cat* -word1*"sv);
+    });
+    CheckAllocations("status"s, 1, [&] {
+        return search_server.FindTopDocuments("cat word3"sv, DocumentStatus::BANNED);
+    });
+    CheckAllocations("predicate"s, 1, [&] {
+        return search_server.FindTopDocuments("catalog"sv, [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 0;
+        });
+    });
+    CheckAllocations("nothing found"s, 0, [&] {
+        return search_server.FindTopDocuments("unknown -cat"sv);
+    });
+
+    if (failure_count > 0) {
+        return 1;
+    }
+    cout << "allocation_test: OK"s << endl;
+    return 0;
+}
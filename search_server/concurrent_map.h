@@ -1,5 +1,6 @@
 #pragma once
 #include <map>
+#include <memory_resource>
 #include <vector>
 #include <mutex>
 
@@ -23,8 +24,8 @@ public:
         }
     };
 
-    explicit ConcurrentMap(size_t part_count)
-        :parts_(part_count)
+    explicit ConcurrentMap(size_t part_count, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        :parts_(part_count, resource)
     {
     }
 
@@ -33,8 +34,8 @@ public:
         return { key, part };
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
+    std::pmr::map<Key, Value> BuildOrdinaryMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        std::pmr::map<Key, Value> result(resource);
         for (auto& [mutex, map] : parts_) {
             std::lock_guard guard(mutex);
             result.insert(map.begin(), map.end());
@@ -50,8 +51,15 @@ public:
 
 private:
     struct Part{
+        using allocator_type = std::pmr::polymorphic_allocator<Part>;
+
+        explicit Part(const allocator_type& allocator)
+            :map(allocator)
+        {
+        }
+
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::pmr::map<Key, Value> map;
     };
-    std::vector<Part> parts_;
+    std::pmr::vector<Part> parts_;
 };
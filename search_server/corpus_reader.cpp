@@ -0,0 +1,152 @@
+#include "corpus_reader.h"
+#include "parallel_chunks.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <execution>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const size_t MIN_CORPUS_CHUNK_SIZE = 1 << 20;
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), path);
+        }
+        data_ = data;
+        madvise(data_, size_, MADV_WILLNEED);
+    }
+    close(fd);
+}
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+}
+string_view MappedFile::Data() const {
+    return { static_cast<const char*>(data_), size_ };
+}
+
+namespace {
+
+[[noreturn]] void ThrowInvalidRecord(string_view line) {
+    throw invalid_argument("Invalid corpus record: "s + string(line.substr(0, 80)));
+}
+string_view NextField(string_view& rest, string_view line) {
+    const size_t tab = rest.find('\t');
+    if (tab == rest.npos) {
+        ThrowInvalidRecord(line);
+    }
+    const string_view field = rest.substr(0, tab);
+    rest.remove_prefix(tab + 1);
+    return field;
+}
+DocumentStatus ParseStatus(string_view field, string_view line) {
+    if (field == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (field == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (field == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (field == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    ThrowInvalidRecord(line);
+}
+CorpusRecord ParseRecord(string_view line) {
+    CorpusRecord record;
+    string_view rest = line;
+    const string_view id = NextField(rest, line);
+    const auto [id_end, id_error] = from_chars(id.data(), id.data() + id.size(), record.id);
+    if (id_error != errc{} || id_end != id.data() + id.size()) {
+        ThrowInvalidRecord(line);
+    }
+    record.status = ParseStatus(NextField(rest, line), line);
+    const string_view ratings = NextField(rest, line);
+    for (const char* it = ratings.data(), *end = ratings.data() + ratings.size(); it != end;) {
+        if (*it == ' ') {
+            ++it;
+            continue;
+        }
+        int rating;
+        const auto [rating_end, rating_error] = from_chars(it, end, rating);
+        if (rating_error != errc{} || (rating_end != end && *rating_end != ' ')) {
+            ThrowInvalidRecord(line);
+        }
+        record.ratings.push_back(rating);
+        it = rating_end;
+    }
+    record.text = rest;
+    return record;
+}
+void ParseChunk(string_view chunk, vector<CorpusRecord>& records) {
+    while (!chunk.empty()) {
+        const size_t line_end = min(chunk.find('\n'), chunk.size());
+        string_view line = chunk.substr(0, line_end);
+        chunk.remove_prefix(min(line_end + 1, chunk.size()));
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            records.push_back(ParseRecord(line));
+        }
+    }
+}
+
+} // namespace
+
+vector<CorpusRecord> ParseCorpus(string_view data) {
+    // Куски режутся по границам строк, чтобы каждый поток разбирал только целые записи.
+    const size_t chunk_count = clamp<size_t>(data.size() / MIN_CORPUS_CHUNK_SIZE, 1,
+        max<size_t>(1, thread::hardware_concurrency() * 4));
+    vector<string_view> chunks;
+    for (size_t i = 1, begin = 0; begin < data.size(); ++i) {
+        size_t end = max(begin, data.size() / chunk_count * i);
+        end = i >= chunk_count ? data.size() : min(data.find('\n', end), data.size() - 1) + 1;
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+
+    vector<vector<CorpusRecord>> chunk_records(chunks.size());
+    ForEachChunkParallel(chunks.size(), [&](size_t i) {
+        ParseChunk(chunks[i], chunk_records[i]);
+    });
+
+    size_t record_count = 0;
+    for (const auto& records : chunk_records) {
+        record_count += records.size();
+    }
+    vector<CorpusRecord> result;
+    result.reserve(record_count);
+    for (auto& records : chunk_records) {
+        move(records.begin(), records.end(), back_inserter(result));
+    }
+    return result;
+}
+void AddCorpusDocuments(SearchServer& search_server, const MappedFile& corpus) {
+    search_server.AddExternalDocuments(execution::par, ParseCorpus(corpus.Data()));
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "search_server.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Файл, отображённый в память только для чтения.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::string_view Data() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Запись корпуса — одна строка из полей через табуляцию:
+// id, статус (ACTUAL, IRRELEVANT, BANNED, REMOVED), рейтинги через пробел, текст до конца строки.
+using CorpusRecord = ExternalDocument;
+
+// Разбирает записи на месте, параллельно по кускам данных. text ссылается на data.
+std::vector<CorpusRecord> ParseCorpus(std::string_view data);
+// Добавляет документы без копирования текста: corpus должен жить дольше search_server.
+void AddCorpusDocuments(SearchServer& search_server, const MappedFile& corpus);
@@ -0,0 +1,199 @@
+#include "doc_id_bitmap.h"
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+uint32_t CountBits(const pmr::vector<uint64_t>& words) {
+    uint32_t count = 0;
+    for (uint64_t word : words) {
+        count += static_cast<uint32_t>(bitset<64>(word).count());
+    }
+    return count;
+}
+
+} // namespace
+
+DocIdBitmap::Container::Container(uint16_t key, const allocator_type& allocator)
+    : key(key)
+    , array(allocator)
+    , bits(allocator)
+{
+}
+DocIdBitmap::Container::Container(const Container& other, const allocator_type& allocator)
+    : key(other.key)
+    , cardinality(other.cardinality)
+    , array(other.array, allocator)
+    , bits(other.bits, allocator)
+{
+}
+DocIdBitmap::Container::Container(Container&& other, const allocator_type& allocator)
+    : key(other.key)
+    , cardinality(other.cardinality)
+    , array(move(other.array), allocator)
+    , bits(move(other.bits), allocator)
+{
+}
+bool DocIdBitmap::Container::IsBitset() const {
+    return !bits.empty();
+}
+bool DocIdBitmap::Container::Contains(uint16_t low) const {
+    if (IsBitset()) {
+        return (bits[low / 64] >> (low % 64)) & 1;
+    }
+    return binary_search(array.begin(), array.end(), low);
+}
+void DocIdBitmap::Container::Add(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low / 64];
+        const uint64_t mask = uint64_t{ 1 } << (low % 64);
+        if (!(word & mask)) {
+            word |= mask;
+            ++cardinality;
+        }
+        return;
+    }
+    const auto it = lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) {
+        array.insert(it, low);
+        ++cardinality;
+        Normalize();
+    }
+}
+void DocIdBitmap::Container::Remove(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low / 64];
+        const uint64_t mask = uint64_t{ 1 } << (low % 64);
+        if (word & mask) {
+            word &= ~mask;
+            --cardinality;
+            Normalize();
+        }
+        return;
+    }
+    const auto it = lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) {
+        array.erase(it);
+        --cardinality;
+    }
+}
+void DocIdBitmap::Container::Unite(const Container& other) {
+    if (!IsBitset() && !other.IsBitset()) {
+        pmr::vector<uint16_t> merged(array.get_allocator());
+        merged.reserve(array.size() + other.array.size());
+        set_union(array.begin(), array.end(), other.array.begin(), other.array.end(), back_inserter(merged));
+        array.swap(merged);
+        cardinality = static_cast<uint32_t>(array.size());
+        Normalize();
+        return;
+    }
+    ToBitset();
+    if (other.IsBitset()) {
+        for (size_t i = 0; i < BITSET_WORD_COUNT; ++i) {
+            bits[i] |= other.bits[i];
+        }
+    }
+    else {
+        for (uint16_t low : other.array) {
+            bits[low / 64] |= uint64_t{ 1 } << (low % 64);
+        }
+    }
+    cardinality = CountBits(bits);
+}
+void DocIdBitmap::Container::ToBitset() {
+    if (IsBitset()) {
+        return;
+    }
+    bits.assign(BITSET_WORD_COUNT, 0);
+    for (uint16_t low : array) {
+        bits[low / 64] |= uint64_t{ 1 } << (low % 64);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+void DocIdBitmap::Container::ToArray() {
+    if (!IsBitset()) {
+        return;
+    }
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t i = 0; i < BITSET_WORD_COUNT; ++i) {
+        for (uint64_t word = bits[i]; word != 0; word &= word - 1) {
+            const uint64_t lowest = word & (~word + 1);
+            array.push_back(static_cast<uint16_t>(i * 64 + bitset<64>(lowest - 1).count()));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+void DocIdBitmap::Container::Normalize() {
+    if (cardinality > ARRAY_CONTAINER_MAX_SIZE) {
+        ToBitset();
+    }
+    else {
+        ToArray();
+    }
+}
+
+DocIdBitmap::DocIdBitmap(pmr::memory_resource* resource)
+    : containers_(resource)
+{
+}
+void DocIdBitmap::Add(uint32_t id) {
+    const uint16_t key = static_cast<uint16_t>(id >> 16);
+    auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.emplace(it, key);
+    }
+    it->Add(static_cast<uint16_t>(id));
+}
+void DocIdBitmap::Remove(uint32_t id) {
+    const uint16_t key = static_cast<uint16_t>(id >> 16);
+    const auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key) {
+        return;
+    }
+    it->Remove(static_cast<uint16_t>(id));
+    if (it->cardinality == 0) {
+        containers_.erase(it);
+    }
+}
+bool DocIdBitmap::Contains(uint32_t id) const {
+    const uint16_t key = static_cast<uint16_t>(id >> 16);
+    const auto it = FindContainer(key);
+    return it != containers_.end() && it->key == key && it->Contains(static_cast<uint16_t>(id));
+}
+size_t DocIdBitmap::Cardinality() const {
+    size_t result = 0;
+    for (const Container& container : containers_) {
+        result += container.cardinality;
+    }
+    return result;
+}
+DocIdBitmap& DocIdBitmap::operator|=(const DocIdBitmap& other) {
+    auto it = containers_.begin();
+    for (const Container& container : other.containers_) {
+        while (it != containers_.end() && it->key < container.key) {
+            ++it;
+        }
+        if (it != containers_.end() && it->key == container.key) {
+            it->Unite(container);
+        }
+        else {
+            it = containers_.insert(it, container);
+        }
+        ++it;
+    }
+    return *this;
+}
+pmr::vector<DocIdBitmap::Container>::iterator DocIdBitmap::FindContainer(uint16_t key) {
+    return lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t key) { return container.key < key; });
+}
+pmr::vector<DocIdBitmap::Container>::const_iterator DocIdBitmap::FindContainer(uint16_t key) const {
+    return lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t key) { return container.key < key; });
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Сжатое множество id документов в духе Roaring: id делится на старшие и младшие
+// 16 бит, и для каждого старшего ключа хранится контейнер — отсортированный массив
+// младших частей, пока их не больше ARRAY_CONTAINER_MAX_SIZE, иначе битовая карта
+// на 65536 бит. Объединение плотных контейнеров выполняется по 64 бита за операцию.
+class DocIdBitmap {
+public:
+    explicit DocIdBitmap(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void Add(uint32_t id);
+    void Remove(uint32_t id);
+    bool Contains(uint32_t id) const;
+    size_t Cardinality() const;
+
+    DocIdBitmap& operator|=(const DocIdBitmap& other);
+
+private:
+    static constexpr size_t ARRAY_CONTAINER_MAX_SIZE = 4096;
+    static constexpr size_t BITSET_WORD_COUNT = (1 << 16) / 64;
+
+    struct Container {
+        using allocator_type = std::pmr::polymorphic_allocator<Container>;
+
+        Container(uint16_t key, const allocator_type& allocator);
+        Container(const Container& other, const allocator_type& allocator);
+        Container(Container&& other, const allocator_type& allocator);
+        Container(const Container& other) = default;
+        Container(Container&& other) = default;
+        Container& operator=(const Container& other) = default;
+        Container& operator=(Container&& other) = default;
+
+        bool IsBitset() const;
+        bool Contains(uint16_t low) const;
+        void Add(uint16_t low);
+        void Remove(uint16_t low);
+        void Unite(const Container& other);
+        void ToBitset();
+        void ToArray();
+        void Normalize();
+
+        uint16_t key;
+        uint32_t cardinality = 0;
+        std::pmr::vector<uint16_t> array;
+        std::pmr::vector<uint64_t> bits;
+    };
+    std::pmr::vector<Container> containers_;
+
+    std::pmr::vector<Container>::iterator FindContainer(uint16_t key);
+    std::pmr::vector<Container>::const_iterator FindContainer(uint16_t key) const;
+};
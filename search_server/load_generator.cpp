@@ -0,0 +1,199 @@
+#include "query_protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Замкнутый цикл: каждое соединение держит pipeline_depth запросов в полёте
+// и отправляет новый запрос сразу после получения ответа.
+struct LoadResult {
+    vector<chrono::nanoseconds> latencies;
+    size_t errors = 0;
+};
+
+int ConnectTo(const string& socket_path) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Invalid socket path"s);
+    }
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, socket_path.size());
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "socket");
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "connect");
+    }
+    return fd;
+}
+void WriteAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t size = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "send");
+        }
+        data.remove_prefix(static_cast<size_t>(size));
+    }
+}
+// Дочитывает из сокета, пока в buffer не окажется целый кадр.
+string ReadFrame(int fd, string& buffer) {
+    char chunk[1 << 16];
+    for (;;) {
+        string_view payload;
+        if (const size_t frame_size = ExtractFrame(buffer, payload)) {
+            string result(payload);
+            buffer.erase(0, frame_size);
+            return result;
+        }
+        const ssize_t size = read(fd, chunk, sizeof(chunk));
+        if (size == 0) {
+            throw runtime_error("Server closed connection"s);
+        }
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "read");
+        }
+        buffer.append(chunk, static_cast<size_t>(size));
+    }
+}
+LoadResult RunConnection(const string& socket_path, const vector<string>& queries, size_t first_query,
+    size_t pipeline_depth, chrono::steady_clock::time_point deadline) {
+    LoadResult result;
+    const int fd = ConnectTo(socket_path);
+    deque<chrono::steady_clock::time_point> in_flight;
+    string input;
+    string frame;
+    size_t next_query = first_query;
+    auto send_next = [&] {
+        frame.clear();
+        AppendFrame(frame, queries[next_query++ % queries.size()]);
+        in_flight.push_back(chrono::steady_clock::now());
+        WriteAll(fd, frame);
+    };
+    try {
+        for (size_t i = 0; i < pipeline_depth; ++i) {
+            send_next();
+        }
+        while (!in_flight.empty()) {
+            const QueryResponse response = DeserializeResponse(ReadFrame(fd, input));
+            const auto now = chrono::steady_clock::now();
+            result.latencies.push_back(now - in_flight.front());
+            in_flight.pop_front();
+            if (response.status != ResponseStatus::OK) {
+                ++result.errors;
+            }
+            if (now < deadline) {
+                send_next();
+            }
+        }
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return result;
+}
+double PercentileUs(const vector<chrono::nanoseconds>& sorted_latencies, double percentile) {
+    if (sorted_latencies.empty()) {
+        return 0.0;
+    }
+    const size_t index = min(sorted_latencies.size() - 1,
+        static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted_latencies.size())));
+    return sorted_latencies[index].count() / 1000.0;
+}
+
+} // namespace
+
+// Использование: load_generator <socket> [connections] [pipeline_depth] [duration_s] < queries
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 5) {
+        cerr << "Usage: "s << argv[0] << " <socket> [connections] [pipeline_depth] [duration_s] < queries"s << endl;
+        return 1;
+    }
+    try {
+        const string socket_path = argv[1];
+        const size_t connection_count = argc > 2 ? stoul(argv[2]) : 4;
+        const size_t pipeline_depth = argc > 3 ? stoul(argv[3]) : 8;
+        const chrono::seconds duration(argc > 4 ? stoll(argv[4]) : 10);
+        if (connection_count == 0 || pipeline_depth == 0) {
+            throw invalid_argument("Connections and pipeline depth must be positive"s);
+        }
+
+        vector<string> queries;
+        for (string line; getline(cin, line);) {
+            if (!line.empty()) {
+                queries.push_back(move(line));
+            }
+        }
+        if (queries.empty()) {
+            throw invalid_argument("No queries on stdin"s);
+        }
+
+        vector<LoadResult> results(connection_count);
+        vector<string> failures(connection_count);
+        const auto start = chrono::steady_clock::now();
+        const auto deadline = start + duration;
+        vector<thread> workers;
+        for (size_t i = 0; i < connection_count; ++i) {
+            workers.emplace_back([&, i] {
+                try {
+                    results[i] = RunConnection(socket_path, queries, i * queries.size() / connection_count,
+                        pipeline_depth, deadline);
+                }
+                catch (const exception& error) {
+                    failures[i] = error.what();
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        vector<chrono::nanoseconds> latencies;
+        size_t errors = 0;
+        for (size_t i = 0; i < connection_count; ++i) {
+            if (!failures[i].empty()) {
+                cerr << "connection "s << i << ": "s << failures[i] << endl;
+            }
+            latencies.insert(latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+            errors += results[i].errors;
+        }
+        sort(latencies.begin(), latencies.end());
+
+        cout << "requests: "s << latencies.size() << ", errors: "s << errors << endl;
+        cout << "throughput: "s << latencies.size() / elapsed.count() << " req/s"s << endl;
+        cout << "latency us: p50 = "s << PercentileUs(latencies, 50)
+             << ", p90 = "s << PercentileUs(latencies, 90)
+             << ", p99 = "s << PercentileUs(latencies, 99)
+             << ", p99.9 = "s << PercentileUs(latencies, 99.9)
+             << ", max = "s << (latencies.empty() ? 0.0 : latencies.back().count() / 1000.0) << endl;
+    }
+    catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
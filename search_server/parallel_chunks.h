@@ -0,0 +1,29 @@
+#pragma once
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+// Вызывает process_chunk(i) для каждого i из [0, chunk_count) параллельно
+// и перебрасывает исключение первого по номеру куска, в котором оно возникло.
+// Исключение внутри execution::par вызвало бы std::terminate, поэтому ошибки переносятся вручную.
+template <typename ChunkFunction>
+void ForEachChunkParallel(size_t chunk_count, ChunkFunction process_chunk) {
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::vector<std::exception_ptr> chunk_errors(chunk_count);
+    std::for_each(std::execution::par, chunk_indexes.begin(), chunk_indexes.end(), [&](size_t chunk) {
+        try {
+            process_chunk(chunk);
+        }
+        catch (...) {
+            chunk_errors[chunk] = std::current_exception();
+        }
+    });
+    for (const auto& error : chunk_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include "query_arena.h"
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+QueryArena::Scope::Scope(QueryArena& arena)
+    : arena_(arena)
+{
+    ++arena_.scope_depth_;
+}
+QueryArena::Scope::~Scope() {
+    if (--arena_.scope_depth_ == 0) {
+        arena_.Reset();
+    }
+}
+QueryArena::QueryArena(size_t block_size, size_t max_retained_size)
+    : max_retained_size_(max(block_size, max_retained_size))
+{
+    blocks_.push_back(MakeBlock(block_size));
+}
+void QueryArena::Reset() noexcept {
+    // Если запрос не уместился в один блок, объединяем блоки, чтобы следующему
+    // такому же запросу хватило первого. Память сверх предела отдаём обратно,
+    // иначе один тяжёлый запрос навсегда закрепил бы её за потоком.
+    // Reset вызывается из деструктора Scope и не должен бросать: если объединённый
+    // блок выделить не удалось, просто оставляем первый блок.
+    if (blocks_.size() > 1) {
+        size_t total_size = 0;
+        for (const Block& block : blocks_) {
+            total_size += block.size;
+        }
+        Block merged{};
+        if (total_size <= max_retained_size_) {
+            try {
+                merged = MakeBlock(total_size);
+            }
+            catch (const bad_alloc&) {
+            }
+        }
+        blocks_.erase(blocks_.begin() + 1, blocks_.end());
+        if (merged.data) {
+            blocks_.front() = move(merged);
+        }
+    }
+    current_block_ = 0;
+    offset_ = 0;
+}
+QueryArena& QueryArena::ForCurrentThread() {
+    thread_local QueryArena arena;
+    return arena;
+}
+QueryArena::Block QueryArena::MakeBlock(size_t size) {
+    // Без make_unique: память арены не нужно заполнять нулями.
+    return { unique_ptr<byte[]>(new byte[size]), size };
+}
+void* QueryArena::do_allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (current_block_ < blocks_.size()) {
+            Block& block = blocks_[current_block_];
+            void* p = block.data.get() + offset_;
+            size_t space = block.size - offset_;
+            if (align(alignment, bytes, p, space)) {
+                offset_ = block.size - space + bytes;
+                return p;
+            }
+            ++current_block_;
+            offset_ = 0;
+            continue;
+        }
+        const size_t size = max(blocks_.back().size * 2, bytes + alignment);
+        blocks_.push_back(MakeBlock(size));
+    }
+}
+void QueryArena::do_deallocate(void*, size_t, size_t) {
+}
+bool QueryArena::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
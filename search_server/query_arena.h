@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Монотонная арена для временных данных одного запроса. Освобождение памяти —
+// пустая операция, а при сбросе блоки (до max_retained_size) не возвращаются в кучу,
+// поэтому в установившемся режиме запросы не обращаются к глобальному аллокатору.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    // Сбрасывает арену при выходе из самой внешней области. Вложенные
+    // запросы в том же потоке продолжают выделять память поверх внешнего.
+    class Scope {
+    public:
+        explicit Scope(QueryArena& arena);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+    private:
+        QueryArena& arena_;
+    };
+
+    // Сверх max_retained_size арена не держит память между запросами.
+    explicit QueryArena(size_t block_size = 64 * 1024, size_t max_retained_size = 1 << 20);
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    void Reset() noexcept;
+    static QueryArena& ForCurrentThread();
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks_;
+    size_t max_retained_size_;
+    size_t current_block_ = 0;
+    size_t offset_ = 0;
+    size_t scope_depth_ = 0;
+
+    static Block MakeBlock(size_t size);
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
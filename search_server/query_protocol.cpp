@@ -0,0 +1,90 @@
+#include "query_protocol.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+void AppendValue(string& out, T value) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+template <typename T>
+T ReadValue(string_view& in) {
+    if (in.size() < sizeof(T)) {
+        throw invalid_argument("Truncated response"s);
+    }
+    T value;
+    memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+}
+
+} // namespace
+
+void AppendFrame(string& out, string_view payload) {
+    if (payload.size() > MAX_FRAME_SIZE) {
+        throw invalid_argument("Frame is too large"s);
+    }
+    AppendValue(out, static_cast<uint32_t>(payload.size()));
+    out.append(payload);
+}
+size_t ExtractFrame(string_view buffer, string_view& payload) {
+    if (buffer.size() < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    const size_t size = ReadValue<uint32_t>(buffer);
+    if (size > MAX_FRAME_SIZE) {
+        throw invalid_argument("Frame is too large"s);
+    }
+    if (buffer.size() < size) {
+        return 0;
+    }
+    payload = buffer.substr(0, size);
+    return FRAME_HEADER_SIZE + size;
+}
+string SerializeDocuments(const vector<Document>& documents) {
+    string out;
+    out.reserve(1 + sizeof(uint32_t) + documents.size() * (2 * sizeof(int32_t) + sizeof(double)));
+    AppendValue(out, static_cast<uint8_t>(ResponseStatus::OK));
+    AppendValue(out, static_cast<uint32_t>(documents.size()));
+    for (const Document& document : documents) {
+        AppendValue(out, static_cast<int32_t>(document.id));
+        AppendValue(out, document.relevance);
+        AppendValue(out, static_cast<int32_t>(document.rating));
+    }
+    return out;
+}
+string SerializeError(ResponseStatus status, string_view message) {
+    if (status == ResponseStatus::OK) {
+        throw invalid_argument("Error response needs an error status"s);
+    }
+    string out;
+    AppendValue(out, static_cast<uint8_t>(status));
+    out.append(message);
+    return out;
+}
+QueryResponse DeserializeResponse(string_view payload) {
+    QueryResponse response;
+    response.status = static_cast<ResponseStatus>(ReadValue<uint8_t>(payload));
+    if (response.status != ResponseStatus::OK) {
+        response.error = string(payload);
+        return response;
+    }
+    const uint32_t count = ReadValue<uint32_t>(payload);
+    // Длина проверяется до reserve, чтобы обрезанный ответ не заказывал память под чужое число документов.
+    if (payload.size() / (2 * sizeof(int32_t) + sizeof(double)) < count) {
+        throw invalid_argument("Truncated response"s);
+    }
+    response.documents.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const int id = ReadValue<int32_t>(payload);
+        const double relevance = ReadValue<double>(payload);
+        const int rating = ReadValue<int32_t>(payload);
+        response.documents.emplace_back(id, relevance, rating);
+    }
+    return response;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "document.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Кадр: длина полезной нагрузки (uint32_t, порядок байт хоста) и сама нагрузка.
+// Запрос — текст поискового запроса, ответ — SerializeDocuments или SerializeError.
+const size_t FRAME_HEADER_SIZE = sizeof(uint32_t);
+const size_t MAX_FRAME_SIZE = 1 << 20;
+
+enum class ResponseStatus : uint8_t {
+    OK,
+    INVALID_QUERY,
+    // Запрос корректен, но сервер не смог его выполнить, например из-за нехватки памяти.
+    INTERNAL_ERROR,
+};
+
+struct QueryResponse {
+    ResponseStatus status = ResponseStatus::OK;
+    std::vector<Document> documents;
+    std::string error;
+};
+
+void AppendFrame(std::string& out, std::string_view payload);
+// Возвращает число байт, занятых кадром, или 0, если кадр ещё не пришёл целиком.
+size_t ExtractFrame(std::string_view buffer, std::string_view& payload);
+
+std::string SerializeDocuments(const std::vector<Document>& documents);
+std::string SerializeError(ResponseStatus status, std::string_view message);
+QueryResponse DeserializeResponse(std::string_view payload);
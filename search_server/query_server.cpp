@@ -0,0 +1,383 @@
+#include "query_server.h"
+#include "query_protocol.h"
+#include <array>
+#include <cerrno>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const uint64_t LISTEN_ID = 0;
+const uint64_t TIMER_ID = 1;
+const uint64_t STOP_ID = 2;
+const uint64_t FIRST_CONNECTION_ID = 3;
+
+int CheckSystemCall(int result, const char* what) {
+    if (result < 0) {
+        throw system_error(errno, generic_category(), what);
+    }
+    return result;
+}
+
+} // namespace
+
+QueryServer::QueryServer(const SearchServer& search_server, QueryServerOptions options)
+    : search_server_(search_server)
+    , options_(move(options))
+    , next_connection_id_(FIRST_CONNECTION_ID)
+{
+    if (options_.max_batch_size == 0) {
+        throw invalid_argument("Batch size must be positive"s);
+    }
+    if (options_.max_pending_requests == 0 || options_.max_output_size == 0) {
+        throw invalid_argument("Connection limits must be positive"s);
+    }
+    if (options_.latency_budget < chrono::microseconds::zero()) {
+        throw invalid_argument("Latency budget must not be negative"s);
+    }
+    sockaddr_un address{};
+    if (options_.socket_path.empty() || options_.socket_path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Invalid socket path"s);
+    }
+    address.sun_family = AF_UNIX;
+    options_.socket_path.copy(address.sun_path, options_.socket_path.size());
+    try {
+        listen_fd_ = CheckSystemCall(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+        // Удаляется только сокет, оставшийся от прошлого запуска: путь мог по ошибке указать на файл пользователя.
+        struct stat path_stat;
+        if (lstat(options_.socket_path.c_str(), &path_stat) == 0) {
+            if (!S_ISSOCK(path_stat.st_mode)) {
+                throw invalid_argument("Socket path exists and is not a socket"s);
+            }
+            CheckSystemCall(unlink(options_.socket_path.c_str()), "unlink");
+        }
+        else if (errno != ENOENT) {
+            CheckSystemCall(-1, "lstat");
+        }
+        CheckSystemCall(bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), "bind");
+        CheckSystemCall(lstat(options_.socket_path.c_str(), &path_stat), "lstat");
+        socket_device_ = path_stat.st_dev;
+        socket_inode_ = path_stat.st_ino;
+        socket_bound_ = true;
+        CheckSystemCall(listen(listen_fd_, SOMAXCONN), "listen");
+        epoll_fd_ = CheckSystemCall(epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+        timer_fd_ = CheckSystemCall(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "timerfd_create");
+        stop_fd_ = CheckSystemCall(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+        for (const auto& [fd, id] : { pair{ listen_fd_, LISTEN_ID }, pair{ timer_fd_, TIMER_ID }, pair{ stop_fd_, STOP_ID } }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = id;
+            CheckSystemCall(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event), "epoll_ctl");
+        }
+    }
+    catch (...) {
+        CloseDescriptors();
+        throw;
+    }
+}
+QueryServer::~QueryServer() {
+    CloseDescriptors();
+}
+void QueryServer::CloseDescriptors() {
+    for (const auto& [id, connection] : connections_) {
+        close(connection.fd);
+    }
+    connections_.clear();
+    for (int fd : { listen_fd_, epoll_fd_, timer_fd_, stop_fd_ }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    // Путь мог занять другой процесс: удаляем его, только если там всё ещё наш сокет.
+    struct stat path_stat;
+    if (socket_bound_ && lstat(options_.socket_path.c_str(), &path_stat) == 0
+        && path_stat.st_dev == socket_device_ && path_stat.st_ino == socket_inode_) {
+        unlink(options_.socket_path.c_str());
+    }
+    socket_bound_ = false;
+    listen_fd_ = epoll_fd_ = timer_fd_ = stop_fd_ = -1;
+}
+void QueryServer::Run() {
+    array<epoll_event, 64> events;
+    for (;;) {
+        const int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            CheckSystemCall(count, "epoll_wait");
+        }
+        bool stop = false;
+        for (int i = 0; i < count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                AcceptConnections();
+            }
+            else if (id == TIMER_ID) {
+                uint64_t expirations;
+                [[maybe_unused]] auto ignored = read(timer_fd_, &expirations, sizeof(expirations));
+            }
+            else if (id == STOP_ID) {
+                stop = true;
+            }
+            else {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    ReadRequests(id, events[i].events);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    WriteResponses(id);
+                }
+            }
+        }
+        if (!batch_.empty() && (stop || chrono::steady_clock::now() >= batch_deadline_)) {
+            FlushBatch();
+        }
+        if (stop) {
+            return;
+        }
+    }
+}
+void QueryServer::Stop() {
+    const uint64_t one = 1;
+    [[maybe_unused]] auto ignored = write(stop_fd_, &one, sizeof(one));
+}
+void QueryServer::AcceptConnections() {
+    for (;;) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Слушающий сокет останется читаемым, и epoll будет будить Run() без конца.
+                // Перестаём его слушать до закрытия какого-нибудь соединения.
+                cerr << "accept4: "s << system_category().message(errno) << endl;
+                SetAcceptEnabled(false);
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                cerr << "accept4: "s << system_category().message(errno) << endl;
+            }
+            return;
+        }
+        const uint64_t id = next_connection_id_++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        Connection connection;
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+        connections_.emplace(id, move(connection));
+    }
+}
+void QueryServer::SetAcceptEnabled(bool enabled) {
+    if (accept_paused_ == !enabled) {
+        return;
+    }
+    epoll_event event{};
+    event.events = enabled ? static_cast<uint32_t>(EPOLLIN) : 0u;
+    event.data.u64 = LISTEN_ID;
+    CheckSystemCall(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, listen_fd_, &event), "epoll_ctl");
+    accept_paused_ = !enabled;
+}
+void QueryServer::ReadRequests(uint64_t connection_id, uint32_t events) {
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    if (connection.read_closed || IsThrottled(connection)) {
+        // EPOLLIN мог устареть: в той же пачке событий FlushBatch другого соединения
+        // дописал сюда ответы и упёр соединение в пределы. Закрываем только при EPOLLHUP/EPOLLERR.
+        if (events & (EPOLLHUP | EPOLLERR)) {
+            CloseConnection(connection_id);
+        }
+        return;
+    }
+    char buffer[1 << 16];
+    while (!IsThrottled(connection)) {
+        const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size > 0) {
+            connection.input.append(buffer, static_cast<size_t>(size));
+            if (!ExtractRequests(connection_id)) {
+                return;
+            }
+        }
+        else if (size == 0) {
+            connection.read_closed = true;
+            break;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        else if (errno != EINTR) {
+            CloseConnection(connection_id);
+            return;
+        }
+    }
+    UpdateConnection(connection_id);
+    if (batch_.size() >= options_.max_batch_size) {
+        FlushBatch();
+    }
+}
+// Переносит целые кадры из входного буфера в пачку, пока соединение не упрётся в пределы.
+// Возвращает false, если соединение закрыто из-за некорректного кадра.
+bool QueryServer::ExtractRequests(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    size_t consumed = 0;
+    try {
+        string_view payload;
+        while (!IsThrottled(connection)) {
+            const size_t frame_size = ExtractFrame(string_view(connection.input).substr(consumed), payload);
+            if (frame_size == 0) {
+                break;
+            }
+            if (batch_.empty()) {
+                batch_deadline_ = chrono::steady_clock::now() + options_.latency_budget;
+                ArmTimer(options_.latency_budget);
+            }
+            batch_.push_back({ connection_id, string(payload) });
+            ++connection.pending_requests;
+            consumed += frame_size;
+        }
+    }
+    catch (const invalid_argument&) {
+        CloseConnection(connection_id);
+        return false;
+    }
+    connection.input.erase(0, consumed);
+    return true;
+}
+bool QueryServer::IsThrottled(const Connection& connection) const {
+    return connection.pending_requests >= options_.max_pending_requests
+        || connection.output.size() - connection.output_offset >= options_.max_output_size;
+}
+void QueryServer::WriteResponses(uint64_t connection_id) {
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t size = send(connection.fd, connection.output.data() + connection.output_offset,
+            connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (size >= 0) {
+            connection.output_offset += static_cast<size_t>(size);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        else if (errno != EINTR) {
+            CloseConnection(connection_id);
+            return;
+        }
+    }
+    if (connection.output_offset == connection.output.size()) {
+        connection.output.clear();
+        connection.output_offset = 0;
+    }
+    // Пока соединение упиралось в пределы, во входном буфере могли остаться кадры,
+    // а новых данных в сокете может и не быть.
+    if (!connection.input.empty() && !IsThrottled(connection) && !ExtractRequests(connection_id)) {
+        return;
+    }
+    UpdateConnection(connection_id);
+}
+void QueryServer::UpdateConnection(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    const bool has_output = !connection.output.empty();
+    if (connection.read_closed && connection.pending_requests == 0 && !has_output) {
+        CloseConnection(connection_id);
+        return;
+    }
+    const bool can_read = !connection.read_closed && !IsThrottled(connection);
+    const uint32_t events = (can_read ? static_cast<uint32_t>(EPOLLIN) : 0u)
+        | (has_output ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event) < 0) {
+            CloseConnection(connection_id);
+            return;
+        }
+        connection.events = events;
+    }
+}
+void QueryServer::CloseConnection(uint64_t connection_id) {
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections_.erase(it);
+    SetAcceptEnabled(true);
+}
+void QueryServer::FlushBatch() {
+    vector<PendingRequest> batch = move(batch_);
+    batch_.clear();
+    ArmTimer(chrono::microseconds::zero());
+    for (size_t begin = 0; begin < batch.size(); begin += options_.max_batch_size) {
+        const size_t end = min(batch.size(), begin + options_.max_batch_size);
+        vector<string> queries;
+        queries.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            queries.push_back(move(batch[i].query));
+        }
+        const auto responses = ExecuteBatch(queries);
+        for (size_t i = begin; i < end; ++i) {
+            auto it = connections_.find(batch[i].connection_id);
+            if (it == connections_.end()) {
+                continue;
+            }
+            --it->second.pending_requests;
+            AppendFrame(it->second.output, responses[i - begin]);
+        }
+    }
+    vector<uint64_t> connection_ids;
+    connection_ids.reserve(batch.size());
+    for (const auto& request : batch) {
+        connection_ids.push_back(request.connection_id);
+    }
+    sort(connection_ids.begin(), connection_ids.end());
+    connection_ids.erase(unique(connection_ids.begin(), connection_ids.end()), connection_ids.end());
+    for (uint64_t connection_id : connection_ids) {
+        WriteResponses(connection_id);
+    }
+}
+vector<string> QueryServer::ExecuteBatch(const vector<string>& queries) const {
+    // Не ProcessQueries: исключение внутри execution::par приводит к std::terminate,
+    // а ошибка в запросе одного клиента, даже нехватка памяти, не должна ронять весь сервер.
+    vector<string> responses(queries.size());
+    transform(execution::par, queries.begin(), queries.end(), responses.begin(),
+        [this](const string& raw_query) {
+            try {
+                return SerializeDocuments(search_server_.FindTopDocuments(raw_query, DocumentStatus::ACTUAL));
+            }
+            catch (const invalid_argument& error) {
+                return SerializeError(ResponseStatus::INVALID_QUERY, error.what());
+            }
+            catch (const exception& error) {
+                return SerializeError(ResponseStatus::INTERNAL_ERROR, error.what());
+            }
+        });
+    return responses;
+}
+void QueryServer::ArmTimer(chrono::microseconds delay) {
+    itimerspec spec{};
+    spec.it_value.tv_sec = static_cast<time_t>(delay.count() / 1000000);
+    spec.it_value.tv_nsec = static_cast<long>(delay.count() % 1000000 * 1000);
+    CheckSystemCall(timerfd_settime(timer_fd_, 0, &spec, nullptr), "timerfd_settime");
+}
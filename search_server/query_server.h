@@ -0,0 +1,77 @@
+#pragma once
+#include "search_server.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+struct QueryServerOptions {
+    std::string socket_path;
+    // Сколько первый запрос пачки может ждать остальных перед выполнением.
+    std::chrono::microseconds latency_budget{200};
+    size_t max_batch_size = 64;
+    // Пределы на соединение: запросы без ответа и неотправленные байты ответов.
+    // Пока предел достигнут, сервер не читает соединение.
+    size_t max_pending_requests = 1024;
+    size_t max_output_size = 4 << 20;
+};
+
+// Принимает конвейерные запросы по Unix-сокету (см. query_protocol.h),
+// собирает их из всех соединений в пачки и выполняет пачку параллельно.
+class QueryServer {
+public:
+    QueryServer(const SearchServer& search_server, QueryServerOptions options);
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+    ~QueryServer();
+
+    void Run();
+    // Можно вызывать из другого потока и из обработчика сигнала.
+    void Stop();
+
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        size_t pending_requests = 0;
+        uint32_t events = 0;
+        bool read_closed = false;
+    };
+    struct PendingRequest {
+        uint64_t connection_id;
+        std::string query;
+    };
+
+    const SearchServer& search_server_;
+    const QueryServerOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    int stop_fd_ = -1;
+    // Файл сокета, созданный bind: деструктор удаляет только его.
+    bool socket_bound_ = false;
+    dev_t socket_device_ = 0;
+    ino_t socket_inode_ = 0;
+    uint64_t next_connection_id_;
+    bool accept_paused_ = false;
+    std::unordered_map<uint64_t, Connection> connections_;
+    std::vector<PendingRequest> batch_;
+    std::chrono::steady_clock::time_point batch_deadline_;
+
+    void AcceptConnections();
+    void SetAcceptEnabled(bool enabled);
+    void ReadRequests(uint64_t connection_id, uint32_t events);
+    bool ExtractRequests(uint64_t connection_id);
+    bool IsThrottled(const Connection& connection) const;
+    void WriteResponses(uint64_t connection_id);
+    void UpdateConnection(uint64_t connection_id);
+    void CloseConnection(uint64_t connection_id);
+    void FlushBatch();
+    std::vector<std::string> ExecuteBatch(const std::vector<std::string>& queries) const;
+    void ArmTimer(std::chrono::microseconds delay);
+    void CloseDescriptors();
+};
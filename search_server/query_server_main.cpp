@@ -0,0 +1,70 @@
+#include "corpus_reader.h"
+#include "query_server.h"
+#include "read_input_functions.h"
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void HandleStopSignal(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+} // namespace
+
+// Использование: query_server <socket> [latency_budget_us] [max_batch_size] [corpus_file] < input
+// Без corpus_file input — строка стоп-слов, число документов, затем по документу в строке.
+// С corpus_file input — только строка стоп-слов, а документы читаются из файла (см. CorpusRecord).
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 5) {
+        cerr << "Usage: "s << argv[0] << " <socket> [latency_budget_us] [max_batch_size] [corpus_file] < input"s << endl;
+        return 1;
+    }
+    try {
+        QueryServerOptions options;
+        options.socket_path = argv[1];
+        if (argc > 2) {
+            options.latency_budget = chrono::microseconds(stoll(argv[2]));
+        }
+        if (argc > 3) {
+            options.max_batch_size = stoul(argv[3]);
+        }
+
+        // Отображение файла объявлено раньше сервера, чтобы пережить его.
+        unique_ptr<MappedFile> corpus;
+        if (argc > 4) {
+            corpus = make_unique<MappedFile>(argv[4]);
+        }
+        SearchServer search_server(ReadLine());
+        if (corpus) {
+            AddCorpusDocuments(search_server, *corpus);
+        }
+        else {
+            const int document_count = ReadLineWithNumber();
+            for (int id = 0; id < document_count; ++id) {
+                search_server.AddDocument(id, ReadLine(), DocumentStatus::ACTUAL, {});
+            }
+        }
+
+        QueryServer server(search_server, options);
+        running_server = &server;
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        cerr << "Serving "s << search_server.GetDocumentCount() << " documents on "s << options.socket_path << endl;
+        server.Run();
+        running_server = nullptr;
+    }
+    catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,33 +1,111 @@
 #include "search_server.h"
+#include "parallel_chunks.h"
 #include <cmath>
 #include <iostream>
 #include <numeric>
+#include <thread>
 
 using namespace std;
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
     const vector<int>& ratings) {
-    if (document_id < 0) {
-        throw invalid_argument("Invalid document_id"s);
+    // Текст делится до вставки, чтобы документ с некорректным словом не оставил следов.
+    auto words = SplitIntoWordsNoStop(document);
+    DocumentData& data = InsertDocumentData(document_id, status, ratings);
+    data.owned_text = document;
+    data.text = data.owned_text;
+    // Слова указывают в document, а индекс должен ссылаться на собственную копию текста.
+    for (auto& word : words) {
+        word = data.text.substr(static_cast<size_t>(word.data() - document.data()), word.size());
     }
-    if ((documents_.count(document_id) > 0)) {
+    IndexDocument(document_id, status, words);
+}
+void SearchServer::AddExternalDocument(int document_id, string_view document, DocumentStatus status,
+    const vector<int>& ratings) {
+    const auto words = SplitIntoWordsNoStop(document);
+    InsertDocumentData(document_id, status, ratings).text = document;
+    IndexDocument(document_id, status, words);
+}
+void SearchServer::AddExternalDocuments(execution::parallel_policy, const vector<ExternalDocument>& documents) {
+    vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const ExternalDocument& document : documents) {
+        if (document.id < 0) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        if (documents_.count(document.id) > 0) {
+            throw invalid_argument("Existing document"s);
+        }
+        document_ids.push_back(document.id);
+    }
+    sort(document_ids.begin(), document_ids.end());
+    if (adjacent_find(document_ids.begin(), document_ids.end()) != document_ids.end()) {
         throw invalid_argument("Existing document"s);
     }
-    string text{ document.begin(), document.end() };
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, text });
-    auto words = SplitIntoWordsNoStop(documents_.at(document_id).text);
-    const double inv_word_count = 1.0 / words.size();
-    for (auto word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        doc_to_word_freq[document_id][word] += inv_word_count;
+
+    // Документы делятся на куски по потокам. Кусок собирает частоты слов своих документов
+    // и свои различные слова, чтобы в словарь последовательно добавлялось только их объединение.
+    const size_t chunk_count = clamp<size_t>(documents.size(), 1, max<size_t>(1, thread::hardware_concurrency() * 4));
+    const auto chunk_begin = [&documents, chunk_count](size_t chunk) {
+        return documents.size() / chunk_count * chunk + min(chunk, documents.size() % chunk_count);
+    };
+    vector<map<string_view, double>> word_freqs(documents.size());
+    vector<vector<string_view>> chunk_words(chunk_count);
+    ForEachChunkParallel(chunk_count, [&](size_t chunk) {
+        vector<string_view>& words = chunk_words[chunk];
+        for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            const auto document_words = SplitIntoWordsNoStop(documents[i].text);
+            const double inv_word_count = 1.0 / document_words.size();
+            for (auto word : document_words) {
+                word_freqs[i][word] += inv_word_count;
+            }
+            for (const auto& [word, freq] : word_freqs[i]) {
+                words.push_back(word);
+            }
+        }
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+    });
+
+    for (const auto& words : chunk_words) {
+        for (auto word : words) {
+            const uint32_t term_id = terms_.Insert(word);
+            if (term_id >= term_postings_.size()) {
+                term_postings_.resize(term_id + 1);
+            }
+        }
+    }
+    // Словарь больше не меняется, и id слов ищутся параллельно.
+    vector<vector<uint32_t>> term_ids(documents.size());
+    ForEachChunkParallel(chunk_count, [&](size_t chunk) {
+        for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            term_ids[i].reserve(word_freqs[i].size());
+            for (const auto& [word, freq] : word_freqs[i]) {
+                term_ids[i].push_back(terms_.Find(word));
+            }
+        }
+    });
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const ExternalDocument& document = documents[i];
+        DocumentData& data = InsertDocumentData(document.id, document.status, document.ratings);
+        data.text = document.text;
+        auto term_id = term_ids[i].begin();
+        for (const auto& [word, freq] : word_freqs[i]) {
+            Postings& postings = term_postings_[*term_id++];
+            // Документы корпуса обычно идут по возрастанию id, и вставка в конец не ищет по дереву.
+            postings.document_freqs.emplace_hint(postings.document_freqs.end(), document.id, freq);
+            postings.AddDocument(document.id);
+        }
+        if (!word_freqs[i].empty()) {
+            doc_to_word_freq.emplace_hint(doc_to_word_freq.end(), document.id, move(word_freqs[i]));
+        }
+        status_to_document_ids_[document.status].Add(document.id);
+        document_ids_.insert(document_ids_.end(), document.id);
     }
-    document_ids_.insert(document_id);
 }
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-        raw_query, [&status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopDocuments(execution::seq, raw_query, status);
 }
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
@@ -55,23 +133,29 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_vi
     if ((document_id < 0) || (documents_.count(document_id) == 0)) {
         throw out_of_range("Document`s id does not exist"s);
     }
-    const auto query = ParseQuery(raw_query, false);
+    QueryArena& arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope arena_scope(arena);
+    const auto query = ParseQuery(raw_query, false, &arena);
+    pmr::vector<uint32_t> minus_term_ids(&arena);
+    FindMinusPrefixTerms(query, minus_term_ids);
+    const auto contains_document = [this, document_id](string_view word) {
+        return WordContainsDocument(word, document_id);
+    };
+    const auto term_contains_document = [this, document_id](uint32_t term_id) {
+        return term_postings_[term_id].Contains(document_id);
+    };
     vector<string_view> matched_words;
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status };
-        }
+    if (any_of(query.minus_words.begin(), query.minus_words.end(), contains_document)
+        || any_of(minus_term_ids.begin(), minus_term_ids.end(), term_contains_document)) {
+        return { matched_words, documents_.at(document_id).status };
     }
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    copy_if(query.plus_words.begin(), query.plus_words.end(), back_inserter(matched_words), contains_document);
+    if (!query.plus_prefixes.empty()) {
+        for (auto prefix : query.plus_prefixes) {
+            AddPrefixMatches(prefix, document_id, matched_words, &arena);
         }
+        sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
     }
     return { matched_words, documents_.at(document_id).status };
 }
@@ -83,17 +167,27 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution
     if ((document_id < 0) || (documents_.count(document_id) == 0)) {
         throw out_of_range("Document`s id does not exist"s);
     }
-    const auto query = ParseQuery(raw_query, true);
-    vector<string_view> matched_words(query.plus_words.size());
-    if (std::any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), [&](string_view word) {
-        return word_to_document_freqs_.at(word).count(document_id);
-        })) {
-        return { {}, documents_.at(document_id).status };
+    QueryArena& arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope arena_scope(arena);
+    const auto query = ParseQuery(raw_query, true, &arena);
+    pmr::vector<uint32_t> minus_term_ids(&arena);
+    FindMinusPrefixTerms(query, minus_term_ids);
+    const auto contains_document = [this, document_id](string_view word) {
+        return WordContainsDocument(word, document_id);
+    };
+    const auto term_contains_document = [this, document_id](uint32_t term_id) {
+        return term_postings_[term_id].Contains(document_id);
+    };
+    if (std::any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), contains_document)
+        || std::any_of(minus_term_ids.begin(), minus_term_ids.end(), term_contains_document)) {
+        return { vector<string_view>{}, documents_.at(document_id).status };
     }
-    auto last = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](string_view word) {
-        return word_to_document_freqs_.at(word).count(document_id);
-        });
+    vector<string_view> matched_words(query.plus_words.size());
+    auto last = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), contains_document);
     matched_words.erase(last, matched_words.end());
+    for (auto prefix : query.plus_prefixes) {
+        AddPrefixMatches(prefix, document_id, matched_words, &arena);
+    }
     sort(execution::par, matched_words.begin(), matched_words.end());
     auto it = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
@@ -105,8 +199,13 @@ void SearchServer::RemoveDocument(int document_id) {
     }
     auto search_doc = doc_to_word_freq.at(document_id);
     for (auto [str, x] : search_doc) {
-        word_to_document_freqs_[str].erase(document_id);
+        const uint32_t term_id = terms_.Find(str);
+        term_postings_[term_id].RemoveDocument(document_id);
+        if (term_postings_[term_id].document_freqs.empty()) {
+            terms_.Erase(str);
+        }
     }
+    status_to_document_ids_[documents_.at(document_id).status].Remove(document_id);
     doc_to_word_freq.erase(document_id);
     documents_.erase(document_id);
     document_ids_.erase(document_id);
@@ -123,12 +222,78 @@ void SearchServer::RemoveDocument(execution::parallel_policy, int document_id) {
         words.push_back(str);
     }
     for_each(execution::par, words.begin(), words.end(), 
-        [this, &document_id](auto word) { word_to_document_freqs_.at(word).erase(document_id);
+        [this, &document_id](auto word) {
+            term_postings_[terms_.Find(word)].RemoveDocument(document_id);
         });
+    for (auto word : words) {
+        if (term_postings_[terms_.Find(word)].document_freqs.empty()) {
+            terms_.Erase(word);
+        }
+    }
+    status_to_document_ids_[documents_.at(document_id).status].Remove(document_id);
     doc_to_word_freq.erase(document_id);
     documents_.erase(document_id);
     document_ids_.erase(document_id);
 }
+void SearchServer::Postings::AddDocument(int document_id) {
+    if (document_ids) {
+        document_ids->Add(document_id);
+    }
+    else if (document_freqs.size() >= POSTINGS_BITMAP_MIN_SIZE) {
+        document_ids = make_unique<DocIdBitmap>();
+        for (const auto& [id, freq] : document_freqs) {
+            document_ids->Add(id);
+        }
+    }
+}
+void SearchServer::Postings::RemoveDocument(int document_id) {
+    document_freqs.erase(document_id);
+    if (!document_ids) {
+        return;
+    }
+    if (document_freqs.size() < POSTINGS_BITMAP_MIN_SIZE / 2) {
+        document_ids.reset();
+    }
+    else {
+        document_ids->Remove(document_id);
+    }
+}
+bool SearchServer::Postings::Contains(int document_id) const {
+    return document_ids ? document_ids->Contains(document_id) : document_freqs.count(document_id) > 0;
+}
+void SearchServer::Postings::UniteInto(DocIdBitmap& documents) const {
+    if (document_ids) {
+        documents |= *document_ids;
+        return;
+    }
+    for (const auto& [id, freq] : document_freqs) {
+        documents.Add(id);
+    }
+}
+SearchServer::DocumentData& SearchServer::InsertDocumentData(int document_id, DocumentStatus status,
+    const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    if ((documents_.count(document_id) > 0)) {
+        throw invalid_argument("Existing document"s);
+    }
+    return documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, {}, {} }).first->second;
+}
+void SearchServer::IndexDocument(int document_id, DocumentStatus status, const vector<string_view>& words) {
+    const double inv_word_count = 1.0 / words.size();
+    for (auto word : words) {
+        const uint32_t term_id = terms_.Insert(word);
+        if (term_id >= term_postings_.size()) {
+            term_postings_.resize(term_id + 1);
+        }
+        term_postings_[term_id].document_freqs[document_id] += inv_word_count;
+        term_postings_[term_id].AddDocument(document_id);
+        doc_to_word_freq[document_id][word] += inv_word_count;
+    }
+    status_to_document_ids_[status].Add(document_id);
+    document_ids_.insert(document_id);
+}
 bool SearchServer::IsStopWord(string_view word) const {
     return stop_words_.count(word) > 0;
 }
@@ -166,16 +331,24 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         is_minus = true;
         word = word.substr(1);
     }
+    bool is_prefix = false;
+    if (!word.empty() && word.back() == '*') {
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw invalid_argument("Query word is invalid");
     }
-    return { word, is_minus, IsStopWord(word) };
+    return { word, is_minus, !is_prefix && IsStopWord(word), is_prefix };
 }
-SearchServer::Query SearchServer::ParseQuery(string_view text, bool is_sorted) const {
-    SearchServer::Query query;
-    for (auto word : SplitIntoWordsView(text)) {
+SearchServer::Query SearchServer::ParseQuery(string_view text, bool is_sorted, pmr::memory_resource* resource) const {
+    SearchServer::Query query(resource);
+    for (auto word : SplitIntoWordsView(text, resource)) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+        if (query_word.is_prefix) {
+            (query_word.is_minus ? query.minus_prefixes : query.plus_prefixes).push_back(query_word.data);
+        }
+        else if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 query.minus_words.push_back(query_word.data);
             }
@@ -193,8 +366,122 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool is_sorted) c
         auto it_m = unique(query.minus_words.begin(), query.minus_words.end());
         query.minus_words.erase(it_m, query.minus_words.end()); 
     }
+    // Одинаковые префиксы дали бы одно слово дважды, поэтому их убираем всегда.
+    for (auto* prefixes : { &query.plus_prefixes, &query.minus_prefixes }) {
+        sort(prefixes->begin(), prefixes->end());
+        prefixes->erase(unique(prefixes->begin(), prefixes->end()), prefixes->end());
+    }
     return query;
 }
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
-}
\ No newline at end of file
+double SearchServer::ComputeInverseDocumentFreq(size_t document_count) const {
+    return log(GetDocumentCount() * 1.0 / document_count);
+}
+const SearchServer::Postings* SearchServer::FindPostings(string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? nullptr : &term_postings_[term_id];
+}
+bool SearchServer::WordContainsDocument(string_view word, int document_id) const {
+    const Postings* postings = FindPostings(word);
+    return postings && postings->Contains(document_id);
+}
+void SearchServer::FindMinusPrefixTerms(const Query& query, pmr::vector<uint32_t>& term_ids) const {
+    for (auto prefix : query.minus_prefixes) {
+        const size_t old_size = term_ids.size();
+        terms_.FindWithPrefix(prefix, MAX_PREFIX_EXPANSION_COUNT + 1, term_ids);
+        if (term_ids.size() - old_size > MAX_PREFIX_EXPANSION_COUNT) {
+            throw invalid_argument("Minus prefix matches too many words"s);
+        }
+    }
+}
+void SearchServer::AddPrefixMatches(string_view prefix, int document_id, vector<string_view>& matched_words,
+    pmr::memory_resource* resource) const {
+    pmr::vector<uint32_t> term_ids(resource);
+    terms_.FindWithPrefix(prefix, MAX_PREFIX_EXPANSION_COUNT, term_ids);
+    sort(term_ids.begin(), term_ids.end());
+    const auto& word_freqs = GetWordFrequencies(document_id);
+    for (auto it = word_freqs.lower_bound(prefix); it != word_freqs.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        if (binary_search(term_ids.begin(), term_ids.end(), terms_.Find(it->first))) {
+            matched_words.push_back(it->first);
+        }
+    }
+}
+const DocIdBitmap& SearchServer::GetStatusDocuments(DocumentStatus status) const {
+    static const DocIdBitmap empty;
+    const auto it = status_to_document_ids_.find(status);
+    if (it == status_to_document_ids_.end()) {
+        return empty;
+    }
+    return it->second;
+}
+pmr::vector<SearchServer::ScoredTerm> SearchServer::CollectPlusTerms(const Query& query, pmr::memory_resource* resource) const {
+    pmr::vector<ScoredTerm> terms(resource);
+    pmr::vector<uint32_t> scored_term_ids(resource);
+    for (auto word : query.plus_words) {
+        const uint32_t term_id = terms_.Find(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            scored_term_ids.push_back(term_id);
+        }
+    }
+    sort(scored_term_ids.begin(), scored_term_ids.end());
+    scored_term_ids.erase(unique(scored_term_ids.begin(), scored_term_ids.end()), scored_term_ids.end());
+    for (uint32_t term_id : scored_term_ids) {
+        const Postings& postings = term_postings_[term_id];
+        terms.push_back({ &postings, ComputeInverseDocumentFreq(postings.document_freqs.size()) });
+    }
+    pmr::vector<uint32_t> term_ids(resource);
+    for (auto prefix : query.plus_prefixes) {
+        term_ids.clear();
+        terms_.FindWithPrefix(prefix, MAX_PREFIX_EXPANSION_COUNT, term_ids);
+        term_ids.erase(remove_if(term_ids.begin(), term_ids.end(), [&scored_term_ids](uint32_t term_id) {
+                return binary_search(scored_term_ids.begin(), scored_term_ids.end(), term_id);
+            }), term_ids.end());
+        if (term_ids.empty()) {
+            continue;
+        }
+        size_t document_count = term_postings_[term_ids.front()].document_freqs.size();
+        if (term_ids.size() > 1) {
+            DocIdBitmap documents(resource);
+            for (uint32_t term_id : term_ids) {
+                term_postings_[term_id].UniteInto(documents);
+            }
+            document_count = documents.Cardinality();
+        }
+        const double inverse_document_freq = ComputeInverseDocumentFreq(document_count);
+        for (uint32_t term_id : term_ids) {
+            terms.push_back({ &term_postings_[term_id], inverse_document_freq });
+        }
+        sort(term_ids.begin(), term_ids.end());
+        const size_t old_size = scored_term_ids.size();
+        scored_term_ids.insert(scored_term_ids.end(), term_ids.begin(), term_ids.end());
+        inplace_merge(scored_term_ids.begin(), scored_term_ids.begin() + old_size, scored_term_ids.end());
+    }
+    return terms;
+}
+const DocIdBitmap* SearchServer::CollectMinusDocuments(const Query& query, DocIdBitmap& storage,
+    pmr::memory_resource* resource) const {
+    const DocIdBitmap* result = nullptr;
+    const auto exclude = [&result, &storage](const Postings& postings) {
+        if (result == nullptr && postings.document_ids) {
+            result = postings.document_ids.get();
+            return;
+        }
+        if (result != &storage) {
+            if (result != nullptr) {
+                storage |= *result;
+            }
+            result = &storage;
+        }
+        postings.UniteInto(storage);
+    };
+    for (auto word : query.minus_words) {
+        if (const Postings* postings = FindPostings(word)) {
+            exclude(*postings);
+        }
+    }
+    pmr::vector<uint32_t> term_ids(resource);
+    FindMinusPrefixTerms(query, term_ids);
+    for (uint32_t term_id : term_ids) {
+        exclude(term_postings_[term_id]);
+    }
+    return result;
+}
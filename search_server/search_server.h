@@ -3,7 +3,12 @@
 #include "paginator.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "doc_id_bitmap.h"
+#include "query_arena.h"
+#include "term_dictionary.h"
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -13,6 +18,18 @@
 #include <execution>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t RELEVANCE_MAP_PART_COUNT = 128;
+const size_t MAX_PREFIX_EXPANSION_COUNT = 64;
+// С какого числа документов у слова строится битовая карта постингов (удаляется, когда их вдвое меньше).
+const size_t POSTINGS_BITMAP_MIN_SIZE = 64;
+
+// Документ, текст которого хранится вне сервера (см. AddExternalDocument).
+struct ExternalDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
 
 class SearchServer {
 public:
@@ -28,6 +45,11 @@ public:
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Текст не копируется: память document должна жить дольше сервера (см. MappedFile).
+    void AddExternalDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Слова и частоты документов считаются параллельно, последовательно идёт только слияние
+    // в словарь и постинги. Если хоть один документ некорректен, не добавляется ни один.
+    void AddExternalDocuments(std::execution::parallel_policy, const std::vector<ExternalDocument>& documents);
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <typename DocumentPredicate>
@@ -51,17 +73,36 @@ public:
     void RemoveDocument(std::execution::parallel_policy, int document_id);
 
 private:
+    // text указывает либо на owned_text, либо на внешнюю память (AddExternalDocument).
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::string text;
+        std::string owned_text;
+        std::string_view text;
     };
     const std::set<std::string, std::less<>> stop_words_;
     std::map<int, std::map<std::string_view, double>> doc_to_word_freq;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    // document_ids — те же постинги в виде битовой карты для быстрых объединений и проверок.
+    // Карта есть только у слов не менее чем из POSTINGS_BITMAP_MIN_SIZE документов: у редких слов
+    // document_freqs и так мала, а копия удвоила бы память постингов. Без карты Contains ищет в document_freqs.
+    struct Postings {
+        std::map<int, double> document_freqs;
+        std::unique_ptr<DocIdBitmap> document_ids;
+
+        // AddDocument вызывается после записи в document_freqs, RemoveDocument сам удаляет из неё.
+        void AddDocument(int document_id);
+        void RemoveDocument(int document_id);
+        bool Contains(int document_id) const;
+        void UniteInto(DocIdBitmap& documents) const;
+    };
+    TermDictionary terms_;
+    std::vector<Postings> term_postings_;
+    std::map<DocumentStatus, DocIdBitmap> status_to_document_ids_;
     std::map<int, DocumentData> documents_;
     std::set<int> document_ids_;
 
+    DocumentData& InsertDocumentData(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+    void IndexDocument(int document_id, DocumentStatus status, const std::vector<std::string_view>& words);
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
@@ -71,24 +112,55 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
     };
+    // Временные данные запроса живут в арене потока (см. QueryArena).
+    // Префиксы — слова запроса вида "cat*" без звёздочки.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource)
+            , minus_words(resource)
+            , plus_prefixes(resource)
+            , minus_prefixes(resource) {
+        }
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<std::string_view> plus_prefixes;
+        std::pmr::vector<std::string_view> minus_prefixes;
+    };
+    struct ScoredTerm {
+        const Postings* postings;
+        double inverse_document_freq;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
-    Query ParseQuery(std::string_view text, bool is_sorted) const;
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
+    Query ParseQuery(std::string_view text, bool is_sorted, std::pmr::memory_resource* resource) const;
+    double ComputeInverseDocumentFreq(size_t document_count) const;
+    const Postings* FindPostings(std::string_view word) const;
+    bool WordContainsDocument(std::string_view word, int document_id) const;
+    // Минус-префикс исключает документы всех слов с этим префиксом, и усечение ослабило бы исключение.
+    // Поэтому запрос с минус-префиксом, у которого больше MAX_PREFIX_EXPANSION_COUNT слов, отклоняется.
+    void FindMinusPrefixTerms(const Query& query, std::pmr::vector<uint32_t>& term_ids) const;
+    // Добавляет слова документа из того же расширения префикса, по которому ранжирует CollectPlusTerms.
+    void AddPrefixMatches(std::string_view prefix, int document_id, std::vector<std::string_view>& matched_words,
+        std::pmr::memory_resource* resource) const;
+    const DocIdBitmap& GetStatusDocuments(DocumentStatus status) const;
+    // Слово запроса с префиксом заменяется не более чем MAX_PREFIX_EXPANSION_COUNT словами индекса
+    // и оценивается как одно слово: по сумме их частот и IDF объединения их постингов.
+    // Каждое слово индекса оценивается один раз: слово, совпавшее с точным словом запроса,
+    // выпадает из раскрытий, а слово из нескольких раскрытий достаётся первому префиксу по алфавиту.
+    std::pmr::vector<ScoredTerm> CollectPlusTerms(const Query& query, std::pmr::memory_resource* resource) const;
+    const DocIdBitmap* CollectMinusDocuments(const Query& query, DocIdBitmap& storage, std::pmr::memory_resource* resource) const;
+    // allowed_documents == nullptr означает, что фильтра по статусу нет.
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsWithFilter(const ExecutionPolicy& policy, std::string_view raw_query,
+        DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query,
+        DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents, std::pmr::memory_resource* resource) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query,
+        DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents, std::pmr::memory_resource* resource) const;
    
 };
 
@@ -106,57 +178,57 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 }
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = SearchServer::ParseQuery(raw_query, false);
-    auto matched_documents = SearchServer::FindAllDocuments(policy, query, document_predicate);
+    return FindTopDocumentsWithFilter(policy, raw_query, document_predicate, nullptr);
+}
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsWithFilter(const ExecutionPolicy& policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents) const {
+    QueryArena& arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope arena_scope(arena);
+    const auto query = SearchServer::ParseQuery(raw_query, false, &arena);
+    auto matched_documents = SearchServer::FindAllDocuments(policy, query, document_predicate, allowed_documents, &arena);
 
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
+    const auto result_end = matched_documents.begin()
+        + std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(policy, matched_documents.begin(), result_end, matched_documents.end(),
         [](const Document& lhs, const Document& rhs) {
             return lhs.relevance > rhs.relevance
                 || (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon() && lhs.rating > rhs.rating);
         });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return { matched_documents.begin(), result_end };
 }
 template <typename ExecutionPolicy>
 vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
-        [&status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopDocumentsWithFilter(policy, raw_query,
+        [](int, DocumentStatus, int) {
+            return true;
+        }, &GetStatusDocuments(status));
 }
 template <typename ExecutionPolicy>
 vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query,
-    DocumentPredicate document_predicate) const {
-   std::map<int, double> document_to_relevance;
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+std::pmr::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query,
+    DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents, std::pmr::memory_resource* resource) const {
+    DocIdBitmap minus_storage(resource);
+    const DocIdBitmap* minus_documents = CollectMinusDocuments(query, minus_storage, resource);
+    std::pmr::map<int, double> document_to_relevance(resource);
+    for (const ScoredTerm& term : CollectPlusTerms(query, resource)) {
+        for (const auto [document_id, term_freq] : term.postings->document_freqs) {
+            if ((minus_documents && minus_documents->Contains(document_id))
+                || (allowed_documents && !allowed_documents->Contains(document_id))) {
+                continue;
+            }
             const auto& document_data = documents_.at(document_id);
             if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                document_to_relevance[document_id] += term_freq * term.inverse_document_freq;
             }
         }
     }
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
-    }
 
-    vector<Document> matched_documents;
+    std::pmr::vector<Document> matched_documents(resource);
+    matched_documents.reserve(document_to_relevance.size());
     for (const auto [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back(
             { document_id, relevance, documents_.at(document_id).rating });
@@ -164,30 +236,30 @@ std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_p
     return matched_documents;
 }
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query,
-    DocumentPredicate document_predicate) const {
-    size_t parts = static_cast<size_t>(word_to_document_freqs_.size());
-    ConcurrentMap<int, double> document_to_relevance(parts);
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](auto word) {
-        if (word_to_document_freqs_.count(word) != 0) {
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.Remove(document_id);
+std::pmr::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query,
+    DocumentPredicate document_predicate, const DocIdBitmap* allowed_documents, std::pmr::memory_resource* resource) const {
+    DocIdBitmap minus_storage(resource);
+    const DocIdBitmap* minus_documents = CollectMinusDocuments(query, minus_storage, resource);
+    const auto plus_terms = CollectPlusTerms(query, resource);
+    // Потоки for_each берут память из синхронизированного пула поверх кучи, а не поверх арены:
+    // пока поток ждёт for_each, TBB может выполнить на нём другой запрос, который
+    // обратится к арене этого потока напрямую, в обход блокировки пула.
+    std::pmr::synchronized_pool_resource pool;
+    ConcurrentMap<int, double> document_to_relevance(RELEVANCE_MAP_PART_COUNT, &pool);
+    for_each(std::execution::par, plus_terms.begin(), plus_terms.end(), [&](const ScoredTerm& term) {
+        for (const auto [document_id, term_freq] : term.postings->document_freqs) {
+            if ((minus_documents && minus_documents->Contains(document_id))
+                || (allowed_documents && !allowed_documents->Contains(document_id))) {
+                continue;
             }
-        }
-    });
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [this, &document_predicate, &document_to_relevance](auto word) {
-        if (word_to_document_freqs_.count(word) != 0) {
-            const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
+            const auto& document_data = documents_.at(document_id);
+            if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                document_to_relevance[document_id].ref_to_value += term_freq * term.inverse_document_freq;
             }
         }
     });
-    vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
+    std::pmr::vector<Document> matched_documents(resource);
+    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap(resource)) {
         matched_documents.push_back(
             { document_id, relevance, documents_.at(document_id).rating });
     }
@@ -20,8 +20,10 @@ vector<string> SplitIntoWords(const string& text) {
     }
     return words;
 }
-vector<string_view> SplitIntoWordsView(string_view str) {
-    vector<string_view> result;
+namespace {
+
+template <typename Container>
+void SplitIntoWordsViewTo(string_view str, Container& result) {
     str.remove_prefix(min(str.size(), str.find_first_not_of(" ")));
     while (!str.empty()) {
         auto space = str.find(' ');
@@ -33,5 +35,17 @@ vector<string_view> SplitIntoWordsView(string_view str) {
             str.remove_prefix(min(str.size(), str.find_first_not_of(" ", space)));
         }
     }
+}
+
+} // namespace
+
+vector<string_view> SplitIntoWordsView(string_view str) {
+    vector<string_view> result;
+    SplitIntoWordsViewTo(str, result);
+    return result;
+}
+pmr::vector<string_view> SplitIntoWordsView(string_view str, pmr::memory_resource* resource) {
+    pmr::vector<string_view> result(resource);
+    SplitIntoWordsViewTo(str, result);
     return result;
 }
\ No newline at end of file
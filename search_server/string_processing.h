@@ -1,10 +1,12 @@
 #pragma once
+#include <memory_resource>
 #include <string>
 #include <set>
 #include <vector>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view text);
+std::pmr::vector<std::string_view> SplitIntoWordsView(std::string_view text, std::pmr::memory_resource* resource);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -0,0 +1,183 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+size_t CommonPrefixLength(string_view lhs, string_view rhs) {
+    size_t length = 0;
+    while (length < lhs.size() && length < rhs.size() && lhs[length] == rhs[length]) {
+        ++length;
+    }
+    return length;
+}
+
+} // namespace
+
+TermDictionary::TermDictionary()
+    : nodes_(1, Node{ 0, 0 })
+{
+}
+uint32_t TermDictionary::Insert(string_view term) {
+    const uint32_t node = InsertNode(term);
+    if (nodes_[node].term_id == NO_TERM) {
+        if (free_term_ids_.empty()) {
+            nodes_[node].term_id = next_term_id_++;
+        }
+        else {
+            nodes_[node].term_id = free_term_ids_.back();
+            free_term_ids_.pop_back();
+        }
+        ++size_;
+    }
+    return nodes_[node].term_id;
+}
+uint32_t TermDictionary::InsertNode(string_view term) {
+    uint32_t node = 0;
+    while (!term.empty()) {
+        uint32_t previous = NO_NODE;
+        uint32_t child = nodes_[node].first_child;
+        while (child != NO_NODE && static_cast<unsigned char>(Label(child)[0]) < static_cast<unsigned char>(term[0])) {
+            previous = child;
+            child = nodes_[child].next_sibling;
+        }
+        uint32_t next;
+        if (child != NO_NODE && Label(child)[0] == term[0]) {
+            const size_t common = CommonPrefixLength(Label(child), term);
+            if (common == nodes_[child].label_length) {
+                node = child;
+                term.remove_prefix(common);
+                continue;
+            }
+            // Разрезаем ребро: новый узел берёт общую часть метки, child — остаток.
+            next = static_cast<uint32_t>(nodes_.size());
+            Node middle{ nodes_[child].label_offset, static_cast<uint32_t>(common) };
+            middle.first_child = child;
+            middle.next_sibling = nodes_[child].next_sibling;
+            nodes_[child].label_offset += static_cast<uint32_t>(common);
+            nodes_[child].label_length -= static_cast<uint32_t>(common);
+            nodes_[child].next_sibling = NO_NODE;
+            nodes_.push_back(middle);
+            term.remove_prefix(common);
+        }
+        else {
+            if (labels_.size() + term.size() > numeric_limits<uint32_t>::max()) {
+                throw length_error("Term dictionary is full"s);
+            }
+            next = static_cast<uint32_t>(nodes_.size());
+            Node leaf{ static_cast<uint32_t>(labels_.size()), static_cast<uint32_t>(term.size()) };
+            leaf.next_sibling = child;
+            labels_.append(term);
+            nodes_.push_back(leaf);
+            term = {};
+        }
+        if (previous == NO_NODE) {
+            nodes_[node].first_child = next;
+        }
+        else {
+            nodes_[previous].next_sibling = next;
+        }
+        node = next;
+    }
+    return node;
+}
+uint32_t TermDictionary::Find(string_view term) const {
+    const uint32_t node = FindNode(term);
+    return node == NO_NODE ? NO_TERM : nodes_[node].term_id;
+}
+void TermDictionary::Erase(string_view term) {
+    const uint32_t node = FindNode(term);
+    if (node == NO_NODE || nodes_[node].term_id == NO_TERM) {
+        return;
+    }
+    free_term_ids_.push_back(nodes_[node].term_id);
+    nodes_[node].term_id = NO_TERM;
+    --size_;
+    if (++erased_since_compaction_ >= max(size_, MIN_COMPACTION_ERASE_COUNT)) {
+        Compact();
+    }
+}
+size_t TermDictionary::Size() const {
+    return size_;
+}
+void TermDictionary::FindWithPrefix(string_view prefix, size_t limit, pmr::vector<uint32_t>& term_ids) const {
+    uint32_t node = 0;
+    while (!prefix.empty()) {
+        uint32_t child = nodes_[node].first_child;
+        while (child != NO_NODE && Label(child)[0] != prefix[0]) {
+            child = nodes_[child].next_sibling;
+        }
+        if (child == NO_NODE) {
+            return;
+        }
+        const string_view label = Label(child);
+        const size_t common = CommonPrefixLength(label, prefix);
+        if (common == prefix.size()) {
+            node = child;
+            break;
+        }
+        if (common < label.size()) {
+            return;
+        }
+        node = child;
+        prefix.remove_prefix(common);
+    }
+    const size_t end_size = limit > numeric_limits<size_t>::max() - term_ids.size()
+        ? numeric_limits<size_t>::max() : term_ids.size() + limit;
+    CollectTerms(node, end_size, term_ids);
+}
+void TermDictionary::Compact() {
+    TermDictionary compacted;
+    string term;
+    CopyTerms(0, term, compacted);
+    compacted.free_term_ids_ = move(free_term_ids_);
+    compacted.next_term_id_ = next_term_id_;
+    compacted.size_ = size_;
+    *this = move(compacted);
+}
+void TermDictionary::CopyTerms(uint32_t node, string& term, TermDictionary& target) const {
+    if (nodes_[node].term_id != NO_TERM) {
+        target.nodes_[target.InsertNode(term)].term_id = nodes_[node].term_id;
+    }
+    for (uint32_t child = nodes_[node].first_child; child != NO_NODE; child = nodes_[child].next_sibling) {
+        term.append(Label(child));
+        CopyTerms(child, term, target);
+        term.resize(term.size() - nodes_[child].label_length);
+    }
+}
+string_view TermDictionary::Label(uint32_t node) const {
+    return string_view(labels_).substr(nodes_[node].label_offset, nodes_[node].label_length);
+}
+uint32_t TermDictionary::FindNode(string_view term) const {
+    uint32_t node = 0;
+    while (!term.empty()) {
+        uint32_t child = nodes_[node].first_child;
+        while (child != NO_NODE && Label(child)[0] != term[0]) {
+            child = nodes_[child].next_sibling;
+        }
+        if (child == NO_NODE) {
+            return NO_NODE;
+        }
+        const string_view label = Label(child);
+        if (term.substr(0, label.size()) != label) {
+            return NO_NODE;
+        }
+        node = child;
+        term.remove_prefix(label.size());
+    }
+    return node;
+}
+void TermDictionary::CollectTerms(uint32_t node, size_t end_size, pmr::vector<uint32_t>& term_ids) const {
+    if (term_ids.size() >= end_size) {
+        return;
+    }
+    if (nodes_[node].term_id != NO_TERM) {
+        term_ids.push_back(nodes_[node].term_id);
+    }
+    for (uint32_t child = nodes_[node].first_child; child != NO_NODE && term_ids.size() < end_size;
+        child = nodes_[child].next_sibling) {
+        CollectTerms(child, end_size, term_ids);
+    }
+}
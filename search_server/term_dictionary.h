@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Словарь слов индекса: сжатое префиксное дерево (radix trie), которое сопоставляет
+// слову плотный id. Узлы лежат в одном массиве и ссылаются друг на друга индексами,
+// метки рёбер — в общем буфере, так что на слово не приходится отдельных выделений
+// памяти. Дети узла упорядочены, поэтому слова с общим префиксом перечисляются
+// в лексикографическом порядке.
+class TermDictionary {
+public:
+    static constexpr uint32_t NO_TERM = std::numeric_limits<uint32_t>::max();
+
+    TermDictionary();
+
+    // Возвращает id слова, добавляя слово при необходимости.
+    uint32_t Insert(std::string_view term);
+    uint32_t Find(std::string_view term) const;
+    // Освобождённый id может достаться следующему добавленному слову. Узлы удалённых
+    // слов остаются в дереве, пока удалений не наберётся столько же, сколько живых слов;
+    // тогда дерево перестраивается без них, а id живых слов сохраняются.
+    void Erase(std::string_view term);
+    size_t Size() const;
+    // Дописывает в term_ids не более limit id слов, начинающихся с prefix.
+    void FindWithPrefix(std::string_view prefix, size_t limit, std::pmr::vector<uint32_t>& term_ids) const;
+
+private:
+    static constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t MIN_COMPACTION_ERASE_COUNT = 1024;
+
+    struct Node {
+        uint32_t label_offset;
+        uint32_t label_length;
+        uint32_t first_child = NO_NODE;
+        uint32_t next_sibling = NO_NODE;
+        uint32_t term_id = NO_TERM;
+    };
+    std::string labels_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_term_ids_;
+    uint32_t next_term_id_ = 0;
+    size_t size_ = 0;
+    size_t erased_since_compaction_ = 0;
+
+    uint32_t InsertNode(std::string_view term);
+    void Compact();
+    void CopyTerms(uint32_t node, std::string& term, TermDictionary& target) const;
+    std::string_view Label(uint32_t node) const;
+    uint32_t FindNode(std::string_view term) const;
+    void CollectTerms(uint32_t node, size_t end_size, std::pmr::vector<uint32_t>& term_ids) const;
+};
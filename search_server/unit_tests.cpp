@@ -0,0 +1,748 @@
+// Модульные тесты структур данных индекса, префиксных запросов, чтения корпуса и сервера запросов.
+#include "corpus_reader.h"
+#include "doc_id_bitmap.h"
+#include "query_protocol.h"
+#include "query_server.h"
+#include "search_server.h"
+#include "term_dictionary.h"
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+int failure_count = 0;
+
+void Check(bool condition, const string& what) {
+    if (!condition) {
+        cerr << "FAILED: "s << what << endl;
+        ++failure_count;
+    }
+}
+
+// Сверяет битовую карту с эталонным множеством на всех id из проверяемых диапазонов.
+void CheckBitmapEquals(const DocIdBitmap& bitmap, const set<uint32_t>& expected,
+    const vector<uint32_t>& probes, const string& what) {
+    Check(bitmap.Cardinality() == expected.size(), what + ": cardinality"s);
+    for (uint32_t id : probes) {
+        if (bitmap.Contains(id) != (expected.count(id) > 0)) {
+            Check(false, what + ": contains "s + to_string(id));
+            return;
+        }
+    }
+}
+vector<uint32_t> MakeProbes(uint32_t begin, uint32_t end) {
+    vector<uint32_t> probes;
+    for (uint32_t id = begin; id < end; ++id) {
+        probes.push_back(id);
+    }
+    return probes;
+}
+
+void TestBitmapSwitchesContainerAtThreshold() {
+    // Контейнер становится битовой картой на 4097-м id и массивом снова на 4096-м.
+    DocIdBitmap bitmap;
+    set<uint32_t> expected;
+    const vector<uint32_t> probes = MakeProbes(0, 1 << 16);
+    for (uint32_t id = 0; id < 4096 * 2; id += 2) {
+        bitmap.Add(id);
+        expected.insert(id);
+    }
+    CheckBitmapEquals(bitmap, expected, probes, "4096 ids in array"s);
+    bitmap.Add(1);
+    expected.insert(1);
+    CheckBitmapEquals(bitmap, expected, probes, "4097 ids in bitset"s);
+    bitmap.Add(1);
+    CheckBitmapEquals(bitmap, expected, probes, "duplicate add to bitset"s);
+    bitmap.Remove(0);
+    expected.erase(0);
+    CheckBitmapEquals(bitmap, expected, probes, "back to array"s);
+    bitmap.Remove(0);
+    CheckBitmapEquals(bitmap, expected, probes, "remove of absent id"s);
+    for (uint32_t id : vector<uint32_t>(expected.begin(), expected.end())) {
+        bitmap.Remove(id);
+    }
+    CheckBitmapEquals(bitmap, {}, probes, "all removed"s);
+}
+void TestBitmapChunkBoundaries() {
+    DocIdBitmap bitmap;
+    set<uint32_t> expected;
+    const vector<uint32_t> ids = { 0, 65535, 65536, 65537, 131071, 131072, UINT32_MAX - 1, UINT32_MAX };
+    for (uint32_t id : ids) {
+        bitmap.Add(id);
+        expected.insert(id);
+    }
+    vector<uint32_t> probes = ids;
+    for (uint32_t id : { 1u, 65534u, 131073u, 196608u, UINT32_MAX - 2 }) {
+        probes.push_back(id);
+    }
+    CheckBitmapEquals(bitmap, expected, probes, "chunk boundaries"s);
+    bitmap.Remove(65536);
+    expected.erase(65536);
+    bitmap.Remove(131072);
+    expected.erase(131072);
+    CheckBitmapEquals(bitmap, expected, probes, "chunk boundaries after remove"s);
+}
+void TestBitmapUniteMixedContainers() {
+    // Каждое сочетание массива и битовой карты, плюс ключи, которые есть только с одной стороны.
+    const auto fill = [](DocIdBitmap& bitmap, set<uint32_t>& expected, uint32_t chunk, uint32_t count, uint32_t step, uint32_t offset) {
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t id = (chunk << 16) + offset + i * step;
+            bitmap.Add(id);
+            expected.insert(id);
+        }
+    };
+    DocIdBitmap lhs;
+    DocIdBitmap rhs;
+    set<uint32_t> expected;
+    set<uint32_t> rhs_expected;
+    fill(lhs, expected, 0, 100, 3, 0);      // массив | массив
+    fill(rhs, rhs_expected, 0, 100, 5, 0);
+    fill(lhs, expected, 1, 5000, 7, 0);     // битовая карта | массив
+    fill(rhs, rhs_expected, 1, 100, 11, 1);
+    fill(lhs, expected, 2, 100, 13, 0);     // массив | битовая карта
+    fill(rhs, rhs_expected, 2, 5000, 9, 1);
+    fill(lhs, expected, 3, 5000, 3, 0);     // битовая карта | битовая карта
+    fill(rhs, rhs_expected, 3, 5000, 3, 1);
+    fill(rhs, rhs_expected, 5, 10, 1, 0);   // ключ только справа
+    fill(lhs, expected, 6, 10, 1, 0);       // ключ только слева
+    fill(lhs, expected, 0, 2000, 2, 1);     // массив | массив с переходом в битовую карту
+    fill(rhs, rhs_expected, 0, 2500, 2, 2);
+    expected.insert(rhs_expected.begin(), rhs_expected.end());
+    lhs |= rhs;
+    CheckBitmapEquals(lhs, expected, MakeProbes(0, 7 << 16), "mixed union"s);
+    CheckBitmapEquals(rhs, rhs_expected, MakeProbes(0, 7 << 16), "union keeps its argument"s);
+}
+void TestBitmapRandomOperations() {
+    mt19937 generator(42);
+    uniform_int_distribution<uint32_t> id_distribution(0, 3 * (1 << 16));
+    DocIdBitmap bitmap;
+    set<uint32_t> expected;
+    for (int i = 0; i < 200000; ++i) {
+        const uint32_t id = id_distribution(generator);
+        if (generator() % 3 == 0) {
+            bitmap.Remove(id);
+            expected.erase(id);
+        }
+        else {
+            bitmap.Add(id);
+            expected.insert(id);
+        }
+    }
+    CheckBitmapEquals(bitmap, expected, MakeProbes(0, 3 * (1 << 16) + 1), "random operations"s);
+}
+
+void TestDictionarySplitsEdges() {
+    // Каждое следующее слово режет ребро предыдущих в новом месте.
+    TermDictionary dictionary;
+    map<string, uint32_t> expected;
+    for (const string& term : { "catalog"s, "cat"s, "category"s, "car"s, "c"s, "dog"s, ""s }) {
+        expected[term] = dictionary.Insert(term);
+    }
+    Check(dictionary.Size() == expected.size(), "dictionary size"s);
+    for (const auto& [term, term_id] : expected) {
+        Check(dictionary.Find(term) == term_id, "find "s + term);
+        Check(dictionary.Insert(term) == term_id, "insert again "s + term);
+    }
+    for (const string& term : { "ca"s, "cata"s, "catalogs"s, "categor"s, "d"s, "x"s }) {
+        Check(dictionary.Find(term) == TermDictionary::NO_TERM, "find missing "s + term);
+    }
+}
+void TestDictionaryReusesErasedIds() {
+    TermDictionary dictionary;
+    const uint32_t cat = dictionary.Insert("cat"s);
+    const uint32_t catalog = dictionary.Insert("catalog"s);
+    dictionary.Erase("cat"s);
+    dictionary.Erase("cat"s);
+    dictionary.Erase("ca"s);
+    Check(dictionary.Size() == 1, "size after erase"s);
+    Check(dictionary.Find("cat"s) == TermDictionary::NO_TERM, "erased term is not found"s);
+    Check(dictionary.Find("catalog"s) == catalog, "erase keeps the longer term"s);
+    Check(dictionary.Insert("dog"s) == cat, "erased id is reused"s);
+    Check(dictionary.Insert("cat"s) != cat, "reinserted term gets a new id"s);
+    Check(dictionary.Size() == 3, "size after reuse"s);
+}
+void TestDictionaryCompactionKeepsIds() {
+    TermDictionary dictionary;
+    map<string, uint32_t> expected;
+    for (int i = 0; i < 5000; ++i) {
+        expected["word"s + to_string(i)] = dictionary.Insert("word"s + to_string(i));
+    }
+    // Дерево перестраивается, когда удалений набирается столько же, сколько живых слов:
+    // здесь после 2500-го удаления и затем каждые следующие 2500.
+    for (int i = 0; i < 5000; i += 2) {
+        dictionary.Erase("word"s + to_string(i));
+        expected.erase("word"s + to_string(i));
+    }
+    for (int i = 0; i < 6000; ++i) {
+        const string term = "term"s + to_string(i);
+        expected[term] = dictionary.Insert(term);
+        dictionary.Erase(term);
+        expected.erase(term);
+    }
+    Check(dictionary.Size() == expected.size(), "size after compaction"s);
+    for (const auto& [term, term_id] : expected) {
+        if (dictionary.Find(term) != term_id) {
+            Check(false, "id after compaction "s + term);
+            return;
+        }
+    }
+    Check(dictionary.Find("word0"s) == TermDictionary::NO_TERM, "erased term after compaction"s);
+}
+void TestDictionaryPrefixLimitIsPerCall() {
+    TermDictionary dictionary;
+    map<string, uint32_t> ids;
+    for (const string& term : { "cab"s, "cat"s, "catalog"s, "category"s, "dog"s, "ca"s }) {
+        ids[term] = dictionary.Insert(term);
+    }
+    pmr::vector<uint32_t> term_ids = { 100, 101, 102 };
+    dictionary.FindWithPrefix("cat"s, 2, term_ids);
+    Check(term_ids == pmr::vector<uint32_t>{ 100, 101, 102, ids["cat"s], ids["catalog"s] },
+        "limit counts only the terms found by this call"s);
+    dictionary.FindWithPrefix("ca"s, 10, term_ids);
+    Check(term_ids.size() == 10 && term_ids[5] == ids["ca"s] && term_ids[6] == ids["cab"s] && term_ids[9] == ids["category"s],
+        "terms come in lexicographic order"s);
+    term_ids.clear();
+    dictionary.FindWithPrefix("x"s, 10, term_ids);
+    dictionary.FindWithPrefix("cats"s, 10, term_ids);
+    dictionary.FindWithPrefix("ca"s, 0, term_ids);
+    Check(term_ids.empty(), "no terms for missing prefixes or zero limit"s);
+    dictionary.FindWithPrefix(""s, numeric_limits<size_t>::max(), term_ids);
+    Check(term_ids.size() == ids.size(), "unlimited expansion of the empty prefix"s);
+}
+void TestMatchPrefixInDocumentWithoutWords() {
+    // У документа из одних стоп-слов нет частот слов, но префиксный запрос к нему допустим.
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "and"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    for (const string& query : { "cat*"s, "-cat*"s, "dog cat*"s }) {
+        try {
+            const auto [words, status] = search_server.MatchDocument(query, 1);
+            const auto [words_par, status_par] = search_server.MatchDocument(execution::par, query, 1);
+            Check(words.empty() && words_par.empty(), "no words matched for "s + query);
+        }
+        catch (const exception& e) {
+            Check(false, "match "s + query + " throws "s + e.what());
+        }
+    }
+}
+void TestPrefixScoredAsOneWord() {
+    // "cat*" раскрывается в cat и catalog и оценивается как одно слово: TF — сумма частот,
+    // IDF — по объединению постингов, то есть log(4 / 3), а не сумма IDF отдельных слов.
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "catalog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "cat catalog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 4 });
+    const map<int, double> expected = { { 1, 0.5 * log(4.0 / 3) }, { 2, log(4.0 / 3) }, { 3, log(4.0 / 3) } };
+    for (const auto& documents : { search_server.FindTopDocuments("cat*"s), search_server.FindTopDocuments(execution::par, "cat*"s) }) {
+        Check(documents.size() == expected.size(), "prefix finds every expansion"s);
+        for (const Document& document : documents) {
+            Check(expected.count(document.id) > 0 && abs(document.relevance - expected.at(document.id)) < 1e-6,
+                "union IDF relevance of document "s + to_string(document.id));
+        }
+    }
+}
+
+void TestOverlappingPlusTermsScoredOnce() {
+    // В "cat cat*" слово cat оценивается как точное, а cat* — только по catalog.
+    // В "ca* cat*" всё раскрытие cat* уже есть в ca*, и запрос равен "ca*".
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "catalog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "cat catalog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 4 });
+    const map<string, map<int, double>> expected = {
+        { "cat cat*"s, { { 1, 0.5 * log(2.0) }, { 2, log(2.0) }, { 3, log(2.0) } } },
+        { "ca* cat*"s, { { 1, 0.5 * log(4.0 / 3) }, { 2, log(4.0 / 3) }, { 3, log(4.0 / 3) } } },
+        { "cat cat"s, { { 1, 0.5 * log(2.0) }, { 3, 0.5 * log(2.0) } } },
+    };
+    for (const auto& [query, relevances] : expected) {
+        for (const auto& documents : { search_server.FindTopDocuments(query), search_server.FindTopDocuments(execution::par, query) }) {
+            Check(documents.size() == relevances.size(), "document count for "s + query);
+            for (const Document& document : documents) {
+                Check(relevances.count(document.id) > 0 && abs(document.relevance - relevances.at(document.id)) < 1e-6,
+                    query + " relevance of document "s + to_string(document.id));
+            }
+        }
+    }
+}
+
+// Документ i содержит слово "cat" + две буквы, порядок которых совпадает с порядком i,
+// так что раскрытие "cat*" ограничением захватывает ровно документы с id < MAX_PREFIX_EXPANSION_COUNT.
+// Последний документ состоит из одного стоп-слова.
+void AddPrefixDocuments(SearchServer& search_server, int word_count) {
+    for (int i = 0; i < word_count; ++i) {
+        const string word = "cat"s + static_cast<char>('a' + i / 26) + static_cast<char>('a' + i % 26);
+        search_server.AddDocument(i, "dog "s + word, DocumentStatus::ACTUAL, { 1 });
+    }
+    search_server.AddDocument(word_count, "and"s, DocumentStatus::ACTUAL, { 1 });
+}
+bool IsFound(const vector<Document>& documents) {
+    return !documents.empty();
+}
+void TestPrefixExpansionCap() {
+    const int word_count = static_cast<int>(MAX_PREFIX_EXPANSION_COUNT) + 6;
+    SearchServer search_server("and"s);
+    AddPrefixDocuments(search_server, word_count);
+    for (int id = 0; id < word_count; ++id) {
+        const auto only_id = [id](int document_id, DocumentStatus, int) {
+            return document_id == id;
+        };
+        const bool in_expansion = id < static_cast<int>(MAX_PREFIX_EXPANSION_COUNT);
+        Check(IsFound(search_server.FindTopDocuments("cat*"s, only_id)) == in_expansion,
+            "plus prefix is capped for document "s + to_string(id));
+        const bool in_minus_expansion = id < 26;
+        Check(IsFound(search_server.FindTopDocuments("dog -cata*"s, only_id)) != in_minus_expansion,
+            "minus prefix excludes document "s + to_string(id));
+        Check(IsFound(search_server.FindTopDocuments(execution::par, "dog -cata*"s, only_id)) != in_minus_expansion,
+            "parallel minus prefix excludes document "s + to_string(id));
+    }
+    Check(IsFound(search_server.FindTopDocuments("dog -cats*"s)), "minus prefix without expansions"s);
+}
+void TestMinusPrefixOverCapRejected() {
+    // Минус-префикс не усекается, и запрос с минус-префиксом шире ограничения отклоняется целиком.
+    SearchServer search_server("and"s);
+    AddPrefixDocuments(search_server, static_cast<int>(MAX_PREFIX_EXPANSION_COUNT));
+    Check(!IsFound(search_server.FindTopDocuments("dog -cat*"s)), "minus prefix at the cap is accepted"s);
+    search_server.AddDocument(static_cast<int>(MAX_PREFIX_EXPANSION_COUNT) + 1, "dog catzz"s, DocumentStatus::ACTUAL, { 1 });
+    const vector<function<void()>> calls = {
+        [&search_server] { search_server.FindTopDocuments("dog -cat*"s); },
+        [&search_server] { search_server.FindTopDocuments(execution::par, "dog -cat*"s); },
+        [&search_server] { search_server.MatchDocument("dog -cat*"s, 0); },
+        [&search_server] { search_server.MatchDocument(execution::par, "dog -cat*"s, 0); },
+    };
+    for (size_t i = 0; i < calls.size(); ++i) {
+        try {
+            calls[i]();
+            Check(false, "minus prefix over the cap is accepted by call "s + to_string(i));
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+}
+void TestPrefixSearchAgreesWithMatch() {
+    // Документ находится поиском тогда и только тогда, когда MatchDocument находит в нём слова.
+    const int word_count = static_cast<int>(MAX_PREFIX_EXPANSION_COUNT) + 6;
+    SearchServer search_server("and"s);
+    AddPrefixDocuments(search_server, word_count);
+    for (const string& query : { "dog -catb*"s, "cat*"s, "dog cat*"s, "catc*"s, "-catb* cat*"s, "catab* -catc*"s, "cat* -dog"s }) {
+        for (int id = 0; id <= word_count; ++id) {
+            const auto only_id = [id](int document_id, DocumentStatus, int) {
+                return document_id == id;
+            };
+            const bool found = IsFound(search_server.FindTopDocuments(query, only_id));
+            const bool found_par = IsFound(search_server.FindTopDocuments(execution::par, query, only_id));
+            const auto [words, status] = search_server.MatchDocument(query, id);
+            const auto [words_par, status_par] = search_server.MatchDocument(execution::par, query, id);
+            if (found != !words.empty() || found_par != found || words != words_par) {
+                Check(false, "search and match disagree on "s + query + " for document "s + to_string(id));
+            }
+        }
+    }
+}
+// Документы, которые находит запрос, по одному на вызов, чтобы не упереться в MAX_RESULT_DOCUMENT_COUNT.
+set<int> FindEach(const SearchServer& search_server, const string& query) {
+    set<int> found;
+    for (int id : search_server) {
+        const auto only_id = [id](int document_id, DocumentStatus, int) {
+            return document_id == id;
+        };
+        const bool found_seq = !search_server.FindTopDocuments(query, only_id).empty();
+        const bool found_par = !search_server.FindTopDocuments(execution::par, query, only_id).empty();
+        const bool matched = !get<0>(search_server.MatchDocument(query, id)).empty();
+        if (found_seq != found_par || found_seq != matched) {
+            Check(false, "search and match disagree on "s + query + " for document "s + to_string(id));
+        }
+        if (found_seq) {
+            found.insert(id);
+        }
+    }
+    return found;
+}
+void TestPostingsBitmapThreshold() {
+    // Постинги cat переходят порог POSTINGS_BITMAP_MIN_SIZE в обе стороны, у dog карты нет никогда.
+    const int last_id = static_cast<int>(POSTINGS_BITMAP_MIN_SIZE) + 1;
+    SearchServer search_server("and"s);
+    search_server.AddDocument(0, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "dog cat"s, DocumentStatus::ACTUAL, { 1 });
+    set<int> only_cat;
+    for (int id = 2; id <= last_id; ++id) {
+        search_server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        only_cat.insert(id);
+    }
+    for (const string& what : { "above threshold"s, "below threshold"s }) {
+        set<int> with_cat = only_cat;
+        with_cat.insert(1);
+        Check(FindEach(search_server, "cat"s) == with_cat && FindEach(search_server, "ca*"s) == with_cat, what + ": plus word"s);
+        Check(FindEach(search_server, "cat -dog"s) == only_cat, what + ": rare minus word"s);
+        Check(FindEach(search_server, "dog -cat"s) == set<int>{ 0 } && FindEach(search_server, "dog -ca*"s) == set<int>{ 0 },
+            what + ": frequent minus word"s);
+        while (only_cat.size() >= POSTINGS_BITMAP_MIN_SIZE / 2 - 1) {
+            search_server.RemoveDocument(*only_cat.begin());
+            only_cat.erase(only_cat.begin());
+        }
+    }
+}
+void TestAddExternalDocumentsMatchesSequential() {
+    const vector<string> texts = { "white cat and fashionable collar"s, "fluffy cat fluffy tail"s, "and"s, ""s,
+        "groomed dog expressive eyes"s, "groomed starling evgeny"s, "cat cat cat dog"s };
+    vector<ExternalDocument> documents;
+    SearchServer sequential("and"s);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        const int id = static_cast<int>(texts.size() - i) * 3;
+        const DocumentStatus status = i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        documents.push_back({ id, status, { static_cast<int>(i), 7 }, texts[i] });
+        sequential.AddExternalDocument(id, texts[i], status, { static_cast<int>(i), 7 });
+    }
+    SearchServer batch("and"s);
+    batch.AddExternalDocuments(execution::par, documents);
+    Check(batch.GetDocumentCount() == sequential.GetDocumentCount(), "batch document count"s);
+    for (const ExternalDocument& document : documents) {
+        Check(batch.GetWordFrequencies(document.id) == sequential.GetWordFrequencies(document.id),
+            "batch word frequencies of document "s + to_string(document.id));
+    }
+    for (const string& query : { "cat"s, "fluffy groomed -tail"s, "cat* dog"s }) {
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const auto expected = sequential.FindTopDocuments(query, status);
+            const auto found = batch.FindTopDocuments(query, status);
+            bool equal = found.size() == expected.size();
+            for (size_t i = 0; equal && i < found.size(); ++i) {
+                equal = found[i].id == expected[i].id && found[i].rating == expected[i].rating
+                    && abs(found[i].relevance - expected[i].relevance) < 1e-9;
+            }
+            Check(equal, "batch search "s + query);
+        }
+    }
+}
+void TestAddExternalDocumentsRejectsWholeBatch() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    const string invalid_word = "dog\x12"s;
+    for (const vector<ExternalDocument>& documents : {
+            vector<ExternalDocument>{ { 2, DocumentStatus::ACTUAL, {}, "dog"sv }, { 1, DocumentStatus::ACTUAL, {}, "bird"sv } },
+            vector<ExternalDocument>{ { 2, DocumentStatus::ACTUAL, {}, "dog"sv }, { 2, DocumentStatus::ACTUAL, {}, "bird"sv } },
+            vector<ExternalDocument>{ { 2, DocumentStatus::ACTUAL, {}, "dog"sv }, { -3, DocumentStatus::ACTUAL, {}, "bird"sv } },
+            vector<ExternalDocument>{ { 2, DocumentStatus::ACTUAL, {}, "dog"sv }, { 3, DocumentStatus::ACTUAL, {}, invalid_word } },
+        }) {
+        try {
+            search_server.AddExternalDocuments(execution::par, documents);
+            Check(false, "invalid batch is accepted"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        Check(search_server.GetDocumentCount() == 1 && search_server.FindTopDocuments("dog"s).empty(),
+            "invalid batch adds nothing"s);
+    }
+}
+void TestAddDocumentRejectsInvalidWord() {
+    const string invalid_text = "dog bird\x12"s;
+    for (bool external : { false, true }) {
+        SearchServer search_server("and"s);
+        search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        try {
+            if (external) {
+                search_server.AddExternalDocument(2, invalid_text, DocumentStatus::ACTUAL, { 1 });
+            }
+            else {
+                search_server.AddDocument(2, invalid_text, DocumentStatus::ACTUAL, { 1 });
+            }
+            Check(false, "document with an invalid word is accepted"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        const auto documents = search_server.FindTopDocuments("dog"s);
+        Check(search_server.GetDocumentCount() == 1 && documents.size() == 1 && abs(documents[0].relevance) < 1e-9,
+            "invalid document adds nothing"s);
+        try {
+            search_server.AddDocument(2, "bird"s, DocumentStatus::ACTUAL, { 1 });
+        }
+        catch (const exception& e) {
+            Check(false, "id of a rejected document is reused: "s + e.what());
+        }
+    }
+}
+string MakeCorpusLine(int id, size_t length) {
+    string line = to_string(id) + "\tACTUAL\t"s + to_string(id % 10) + " -1\tword"s + to_string(id) + " "s;
+    line.append(length - 1 - line.size(), 'x');
+    return line + "\n"s;
+}
+// Корпус ровно из size байт, где '\n' стоит в позиции newline_position. Строки нумеруются с 1,
+// последняя строка остаётся без '\n', если has_final_newline == false.
+string MakeCorpus(size_t size, size_t newline_position, bool has_final_newline) {
+    const size_t line_length = 100;
+    string corpus;
+    int id = 0;
+    while (corpus.size() + 2 * line_length <= newline_position + 1) {
+        corpus += MakeCorpusLine(++id, line_length);
+    }
+    corpus += MakeCorpusLine(++id, newline_position + 1 - corpus.size());
+    while (corpus.size() + 2 * line_length <= size) {
+        corpus += MakeCorpusLine(++id, line_length);
+    }
+    corpus += MakeCorpusLine(++id, size - corpus.size());
+    if (!has_final_newline) {
+        corpus.back() = 'x';
+    }
+    return corpus;
+}
+void CheckCorpusRecords(string_view corpus, const string& what) {
+    vector<CorpusRecord> records;
+    try {
+        records = ParseCorpus(corpus);
+    }
+    catch (const exception& e) {
+        Check(false, what + ": throws "s + e.what());
+        return;
+    }
+    const int expected_count = static_cast<int>(count(corpus.begin(), corpus.end(), '\n') + (corpus.back() != '\n'));
+    Check(static_cast<int>(records.size()) == expected_count, what + ": record count"s);
+    for (int i = 0; i < static_cast<int>(records.size()); ++i) {
+        const CorpusRecord& record = records[i];
+        const string text_prefix = "word"s + to_string(i + 1) + " "s;
+        if (record.id != i + 1 || record.status != DocumentStatus::ACTUAL || record.ratings != vector<int>{ (i + 1) % 10, -1 }
+            || record.text.substr(0, text_prefix.size()) != text_prefix || record.text.find_first_of("\t\n"s) != string_view::npos) {
+            Check(false, what + ": record "s + to_string(i + 1));
+            return;
+        }
+    }
+}
+void TestParseCorpusChunkBoundaries() {
+    // Вход от 2 МиБ делится на куски по 1 МиБ; граница куска ищет '\n' начиная со своей позиции.
+    const size_t mebibyte = 1 << 20;
+    for (size_t chunk_count : { 2, 3 }) {
+        for (size_t offset : { 0, 1, 2 }) {
+            const size_t newline_position = mebibyte + offset - 1;
+            for (bool has_final_newline : { true, false }) {
+                const string what = "chunks "s + to_string(chunk_count) + ", newline at boundary"s
+                    + (offset == 1 ? ""s : offset == 0 ? " - 1"s : " + 1"s) + (has_final_newline ? ""s : ", no final newline"s);
+                CheckCorpusRecords(MakeCorpus(chunk_count * mebibyte, newline_position, has_final_newline), what);
+            }
+        }
+    }
+}
+void TestParseCorpusLineEndings() {
+    const auto records = ParseCorpus("1\tACTUAL\t1 2\tcat dog\r\n\r\n\n2\tBANNED\t\tbird\r\n3\tREMOVED\t-4\t"sv);
+    Check(records.size() == 3, "CRLF record count"s);
+    if (records.size() == 3) {
+        Check(records[0].id == 1 && records[0].ratings == vector<int>{ 1, 2 } && records[0].text == "cat dog"sv, "CRLF record"s);
+        Check(records[1].status == DocumentStatus::BANNED && records[1].ratings.empty() && records[1].text == "bird"sv,
+            "empty ratings"s);
+        Check(records[2].status == DocumentStatus::REMOVED && records[2].ratings == vector<int>{ -4 } && records[2].text.empty(),
+            "no final newline and empty text"s);
+    }
+    Check(ParseCorpus(""sv).empty() && ParseCorpus("\n\r\n"sv).empty(), "no records"s);
+}
+void TestParseCorpusRejectsMalformedRecords() {
+    for (const string& corpus : {
+            "x1\tACTUAL\t1\tcat\n"s, "1x\tACTUAL\t1\tcat\n"s, "\tACTUAL\t1\tcat\n"s, " 1\tACTUAL\t1\tcat\n"s,
+            "99999999999\tACTUAL\t1\tcat\n"s, "1\tactual\t1\tcat\n"s, "1\t\t1\tcat\n"s, "1\tACTUAL\t1,2\tcat\n"s,
+            "1\tACTUAL\ta\tcat\n"s, "1\tACTUAL\t1x 2\tcat\n"s, "1\tACTUAL\t99999999999\tcat\n"s, "1\tACTUAL\t1\n"s,
+            "1\tACTUAL\n"s, "1\n"s, "1\tACTUAL\t1\tcat\r\n2\tACTUAL\t1\tdog\r\nbad\r\n"s,
+        }) {
+        try {
+            ParseCorpus(corpus);
+            Check(false, "malformed record is accepted: "s + corpus);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    // Ошибка из второго куска тоже доходит до вызывающего.
+    string corpus = MakeCorpus(2 << 20, 1 << 20, true);
+    corpus.replace(corpus.size() - 50, 1, "\n\t\n"s);
+    try {
+        ParseCorpus(corpus);
+        Check(false, "malformed record in the last chunk is accepted"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+void TestExtractFrame() {
+    string buffer;
+    AppendFrame(buffer, "cat dog"sv);
+    AppendFrame(buffer, ""sv);
+    AppendFrame(buffer, "bird"sv);
+    string_view payload;
+    for (size_t size = 0; size < FRAME_HEADER_SIZE + 7; ++size) {
+        Check(ExtractFrame(string_view(buffer).substr(0, size), payload) == 0,
+            "partial frame of "s + to_string(size) + " bytes"s);
+    }
+    vector<string> payloads;
+    for (string_view rest = buffer; !rest.empty();) {
+        const size_t frame_size = ExtractFrame(rest, payload);
+        if (frame_size == 0) {
+            Check(false, "several frames in one buffer"s);
+            break;
+        }
+        payloads.emplace_back(payload);
+        rest.remove_prefix(frame_size);
+    }
+    Check(payloads == vector<string>{ "cat dog"s, ""s, "bird"s }, "payloads of several frames"s);
+
+    string large;
+    const uint32_t large_size = static_cast<uint32_t>(MAX_FRAME_SIZE) + 1;
+    large.append(reinterpret_cast<const char*>(&large_size), sizeof(large_size));
+    try {
+        ExtractFrame(large, payload);
+        Check(false, "frame over MAX_FRAME_SIZE is accepted"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+void TestResponseRoundTrip() {
+    const vector<Document> documents = { { 3, 0.25, -1 }, { 1, 1e-9, 7 } };
+    const QueryResponse response = DeserializeResponse(SerializeDocuments(documents));
+    bool equal = response.status == ResponseStatus::OK && response.documents.size() == documents.size();
+    for (size_t i = 0; equal && i < documents.size(); ++i) {
+        equal = response.documents[i].id == documents[i].id && response.documents[i].relevance == documents[i].relevance
+            && response.documents[i].rating == documents[i].rating;
+    }
+    Check(equal, "documents round trip"s);
+    Check(DeserializeResponse(SerializeDocuments({})).documents.empty(), "empty result round trip"s);
+    for (ResponseStatus status : { ResponseStatus::INVALID_QUERY, ResponseStatus::INTERNAL_ERROR }) {
+        const QueryResponse error = DeserializeResponse(SerializeError(status, "Query word is empty"sv));
+        Check(error.status == status && error.error == "Query word is empty"s && error.documents.empty(), "error round trip"s);
+    }
+
+    string serialized = SerializeDocuments(documents);
+    // Число документов без самих документов не должно заказывать память под них.
+    string huge_count = serialized.substr(0, 1) + string(sizeof(uint32_t), '\xff');
+    for (string_view truncated : { string_view(serialized).substr(0, serialized.size() - 1), string_view(serialized).substr(0, 3),
+            ""sv, string_view(huge_count) }) {
+        try {
+            DeserializeResponse(truncated);
+            Check(false, "truncated response of "s + to_string(truncated.size()) + " bytes is accepted"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+}
+// Клиент для проверки сервера: блокирующие отправка и чтение целого кадра.
+int ConnectTo(const string& socket_path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, socket_path.size());
+    if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+        return fd;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+bool SendAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t size = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (size <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(size));
+    }
+    return true;
+}
+bool ReceiveFrame(int fd, string& input, string& payload) {
+    for (;;) {
+        string_view frame;
+        const size_t frame_size = ExtractFrame(input, frame);
+        if (frame_size > 0) {
+            payload = string(frame);
+            input.erase(0, frame_size);
+            return true;
+        }
+        char buffer[4096];
+        const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+            return false;
+        }
+        input.append(buffer, static_cast<size_t>(size));
+    }
+}
+void TestQueryServerPipelinedRequests() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "bird"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "cat bird"s, DocumentStatus::ACTUAL, { 3 });
+    QueryServerOptions options;
+    options.socket_path = "/tmp/search_server_unit_tests_"s + to_string(getpid()) + ".sock"s;
+    options.max_batch_size = 2;
+    QueryServer query_server(search_server, options);
+    thread server_thread([&query_server] { query_server.Run(); });
+
+    const vector<string> queries = { "cat"s, "bird"s, "cat --dog"s, "dog"s, "fish"s, "cat -dog"s, "bird*"s };
+    string requests;
+    for (const string& query : queries) {
+        AppendFrame(requests, query);
+    }
+    const int fd = ConnectTo(options.socket_path);
+    Check(fd >= 0 && SendAll(fd, requests), "pipelined requests are sent"s);
+    string input;
+    for (const string& query : queries) {
+        string payload;
+        if (fd < 0 || !ReceiveFrame(fd, input, payload)) {
+            Check(false, "response to "s + query);
+            break;
+        }
+        const QueryResponse response = DeserializeResponse(payload);
+        if (query == "cat --dog"s) {
+            Check(response.status == ResponseStatus::INVALID_QUERY && !response.error.empty(), "invalid query is reported"s);
+            continue;
+        }
+        const auto expected = search_server.FindTopDocuments(query);
+        bool equal = response.status == ResponseStatus::OK && response.documents.size() == expected.size();
+        for (size_t i = 0; equal && i < expected.size(); ++i) {
+            equal = response.documents[i].id == expected[i].id && response.documents[i].rating == expected[i].rating;
+        }
+        Check(equal, "response in request order for "s + query);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    query_server.Stop();
+    server_thread.join();
+}
+
+int main() {
+    TestBitmapSwitchesContainerAtThreshold();
+    TestBitmapChunkBoundaries();
+    TestBitmapUniteMixedContainers();
+    TestBitmapRandomOperations();
+    TestDictionarySplitsEdges();
+    TestDictionaryReusesErasedIds();
+    TestDictionaryCompactionKeepsIds();
+    TestDictionaryPrefixLimitIsPerCall();
+    TestMatchPrefixInDocumentWithoutWords();
+    TestPrefixScoredAsOneWord();
+    TestOverlappingPlusTermsScoredOnce();
+    TestPrefixExpansionCap();
+    TestMinusPrefixOverCapRejected();
+    TestPrefixSearchAgreesWithMatch();
+    TestPostingsBitmapThreshold();
+    TestAddExternalDocumentsMatchesSequential();
+    TestAddExternalDocumentsRejectsWholeBatch();
+    TestAddDocumentRejectsInvalidWord();
+    TestParseCorpusChunkBoundaries();
+    TestParseCorpusLineEndings();
+    TestParseCorpusRejectsMalformedRecords();
+    TestExtractFrame();
+    TestResponseRoundTrip();
+    TestQueryServerPipelinedRequests();
+    if (failure_count > 0) {
+        return 1;
+    }
+    cout << "unit_tests: OK"s << endl;
+    return 0;
+}